@@ -65,19 +65,23 @@ BOOLEAN pl330_dma_irq(WDFINTERRUPT Interrupt, ULONG MessageID) {
 
 	BOOLEAN queueDPC = FALSE;
 
-	val = read32(pDevice, ES);
-	pDevice->irqLastEvents = val;
-	for (UINT32 ev = 0; ev < pDevice->Config.NumEvents; ev++) {
-		if (val & (1 << ev)) { /* Event occurred */
+	val = read32(pDevice, ES) & read32(pDevice, INTEN);
+	val &= (1 << pDevice->Config.NumChan) - 1; /* Thread i signals event i */
+	if (val) {
+		write32(pDevice, INTCLR, val); //Clear the events
+
+		/* Count first, so a DPC that sees the bit also sees the count */
+		for (UINT32 pending = val; pending; pending &= pending - 1) {
+			ULONG ev;
+			_BitScanForward(&ev, pending);
 			Pl330DmaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL, "Event on channel %d\n", ev);
+			InterlockedIncrement(&pDevice->Channels[ev].PendingEvents);
+		}
 
-			UINT32 intEn = read32(pDevice, INTEN);
-			if (intEn & (1 << ev)) {
-				write32(pDevice, INTCLR, (1 << ev)); //Clear the event
+		/* Accumulate, the DPC may not have consumed the previous events yet */
+		InterlockedOr(&pDevice->irqLastEvents, (LONG)val);
 
-				queueDPC = TRUE;
-			}
-		}
+		queueDPC = TRUE;
 	}
 
 	if (queueDPC) {
@@ -93,16 +97,39 @@ void pl330_dma_dpc(WDFINTERRUPT Interrupt, WDFOBJECT AssociatedObject) {
 	WDFDEVICE Device = WdfInterruptGetDevice(Interrupt);
 	PPL330DMA_CONTEXT pDevice = GetDeviceContext(Device);
 
-	UINT32 val = pDevice->irqLastEvents;
-	for (UINT32 ev = 0; ev < pDevice->Config.NumEvents; ev++) {
-		if (val & (1 << ev)) { /* Event occurred */
-			PPL330DMA_THREAD Thread = &pDevice->Channels[ev];
-			for (int regEv = 0; regEv < MAX_NOTIF_EVENTS; regEv++) {
-				if (Thread->registeredCallbacks[regEv].InUse) {
-					Thread->registeredCallbacks[regEv].NotificationCallback(Thread->registeredCallbacks[regEv].CallbackContext);
-				}
+	PPL330DMA_THREAD_CALLBACK callbacks[MAX_NOTIF_EVENTS];
+
+	UINT32 val = (UINT32)InterlockedExchange(&pDevice->irqLastEvents, 0);
+	for (; val; val &= val - 1) {
+		ULONG ev;
+		_BitScanForward(&ev, val);
+
+		PPL330DMA_THREAD Thread = &pDevice->Channels[ev];
+
+		KeAcquireSpinLockAtDpcLevel(&pDevice->Lock);
+		_complete(Thread);
+		/*
+		 * Pin what's registered now. Unregister unlinks under the lock
+		 * before it waits, so acquiring here can't fail.
+		 */
+		UINT8 numCallbacks = Thread->NumCallbacks;
+		for (UINT8 i = 0; i < numCallbacks; i++) {
+			callbacks[i] = Thread->registeredCallbacks[i];
+			ExAcquireRundownProtection(&callbacks[i]->Rundown);
+		}
+		KeReleaseSpinLockFromDpcLevel(&pDevice->Lock);
+
+		/* One notification per SEV, even if several arrived before this DPC */
+		LONG count = InterlockedExchange(&Thread->PendingEvents, 0);
+		while (count-- > 0) {
+			for (UINT8 i = 0; i < numCallbacks; i++) {
+				callbacks[i]->NotificationCallback(callbacks[i]->CallbackContext);
 			}
 		}
+
+		for (UINT8 i = 0; i < numCallbacks; i++) {
+			ExReleaseRundownProtection(&callbacks[i]->Rundown);
+		}
 	}
 }
 
@@ -110,7 +137,13 @@ void pl330_dma_dpc(WDFINTERRUPT Interrupt, WDFOBJECT AssociatedObject) {
 static NTSTATUS UntilDmacIdle(PPL330DMA_THREAD Thread)
 {
 	PPL330DMA_CONTEXT pDevice = Thread->Device;
-	UINT32 timeout_us = 5 * 1000; // 5 ms
+	/*
+	 * Every debug instruction is issued under pDevice->Lock, so the only
+	 * thing the interface can be busy with is our previous GO/KILL, which
+	 * the manager takes in a few cycles. Don't spin for long with the lock
+	 * held: busy for 50us means the DMAC is hung.
+	 */
+	UINT32 timeout_us = 50;
 
 	LARGE_INTEGER StartTime;
 	KeQuerySystemTimePrecise(&StartTime);
@@ -236,6 +269,25 @@ static inline UINT32 _state(PPL330DMA_THREAD Thread)
 	}
 }
 
+/* The running req has ended or been killed: release its slot */
+void _retire(PPL330DMA_THREAD Thread)
+{
+	PPL330DMA_REQ pReq;
+
+	if (Thread->ReqRunning == -1)
+		return;
+
+	pReq = &Thread->Req[Thread->ReqRunning];
+
+	/* Drop any lines the CPU speculatively pulled in while the DMAC wrote */
+	for (PMDL mdl = pReq->Mdl; mdl; mdl = mdl->Next)
+		KeFlushIoBuffers(mdl, TRUE, TRUE);
+	pReq->Mdl = NULL;
+
+	pReq->InUse = FALSE;
+	Thread->ReqRunning = -1;
+}
+
 void _stop(PPL330DMA_THREAD Thread)
 {
 	PPL330DMA_CONTEXT pDevice = Thread->Device;
@@ -261,7 +313,7 @@ void _stop(PPL330DMA_THREAD Thread)
 	/* Stop generating interrupts for SEV */
 	write32(pDevice, INTEN, inten & ~(1 << Thread->ev));
 
-	Thread->ReqRunning = FALSE;
+	_retire(Thread);
 }
 
 /* Start doing req 'idx' of thread 'Thread' */
@@ -271,18 +323,27 @@ static BOOLEAN _trigger(PPL330DMA_THREAD Thread)
 	PPL330DMA_REQ pReq;
 	struct _arg_GO go;
 	unsigned ns;
+	int idx;
 	UINT8 insn[6] = { 0, 0, 0, 0, 0, 0 };
 
 	/* Return if already ACTIVE */
 	if (_state(Thread) != PL330_STATE_STOPPED)
 		return TRUE;
 
-	pReq = &Thread->Req[0];
+	/* A stopped thread has hit DMAEND (or was killed), so its req is done */
+	_retire(Thread);
+
+	/* Oldest queued req first */
+	idx = 1 - Thread->LastEnqueued;
+	if (!Thread->Req[idx].InUse)
+		idx = Thread->LastEnqueued;
 
-	/* Return if req is running */
-	if (Thread->ReqRunning)
+	/* Return if nothing is queued */
+	if (!Thread->Req[idx].InUse)
 		return TRUE;
 
+	pReq = &Thread->Req[idx];
+
 	ns = 1; //Always Non-Secure
 
 	/* See 'Abort Sources' point-4 at Page 2-25 */
@@ -304,7 +365,7 @@ static BOOLEAN _trigger(PPL330DMA_THREAD Thread)
 	/* Only manager can execute GO */
 	_execute_DBGINSN(Thread, insn, TRUE);
 
-	Thread->ReqRunning = TRUE;
+	Thread->ReqRunning = idx;
 
 	return TRUE;
 }
@@ -340,4 +401,62 @@ BOOLEAN _start(PPL330DMA_THREAD Thread)
 	default:
 		return FALSE;
 	}
-}
\ No newline at end of file
+}
+
+/*
+ * Free microcode slot for the next request, NULL if both are taken or a
+ * cyclic req is queued/running: it never ends, so a req behind it would
+ * never start.
+ */
+PPL330DMA_REQ _get_req(PPL330DMA_THREAD Thread)
+{
+	int idx = 1 - Thread->LastEnqueued;
+
+	for (int i = 0; i < 2; i++) {
+		if (Thread->Req[i].InUse && !Thread->Req[i].EndOff)
+			return NULL;
+	}
+
+	if (Thread->Req[idx].InUse)
+		idx = Thread->LastEnqueued;
+	if (Thread->Req[idx].InUse)
+		return NULL;
+
+	return &Thread->Req[idx];
+}
+
+/* Queue a prepared req behind the running one, start it if the thread is idle */
+BOOLEAN _submit(PPL330DMA_THREAD Thread, PPL330DMA_REQ pReq)
+{
+	BOOLEAN started;
+
+	pReq->InUse = TRUE;
+	Thread->LastEnqueued = (int)(pReq - Thread->Req);
+
+	started = _start(Thread);
+	if (!started)
+		pReq->InUse = FALSE;
+
+	return started;
+}
+
+/* Event from the thread: retire a finished one-shot req and chain the next */
+void _complete(PPL330DMA_THREAD Thread)
+{
+	PPL330DMA_CONTEXT pDevice = Thread->Device;
+	PPL330DMA_REQ pReq;
+
+	if (Thread->ReqRunning == -1)
+		return;
+
+	/* Cyclic programs signal every period and never end */
+	pReq = &Thread->Req[Thread->ReqRunning];
+	if (!pReq->EndOff)
+		return;
+
+	/* SEV comes right before DMAEND, so it may not have retired yet */
+	if (read32(pDevice, CPC(Thread->Id)) == pReq->MCbus.LowPart + pReq->EndOff)
+		UNTIL(Thread, PL330_STATE_STOPPED | PL330_STATE_FAULTING);
+
+	_start(Thread);
+}
@@ -60,15 +60,22 @@ typedef struct _PL330DMA_REQ {
     PHYSICAL_ADDRESS MCbus;
     UINT8* MCcpu;
     XFER_SPEC Xfer;
+    /* Queued or running, microcode must not be touched */
+    BOOLEAN InUse;
+    /* Offset of DMAEND for one-shot programs, 0 for cyclic ones */
+    UINT32 EndOff;
+    /* Device-to-memory MDL chain, flushed again once the transfer is done */
+    PMDL Mdl;
 } PL330DMA_REQ, *PPL330DMA_REQ;
 
 struct _PL330DMA_CONTEXT;
 
 typedef struct _PL330DMA_THREAD_CALLBACK {
-    BOOLEAN InUse;
     PDEVICE_OBJECT Fdo;
     PDMA_NOTIFICATION_CALLBACK NotificationCallback;
     PVOID CallbackContext;
+    /* Held by the DPC across the call, unregister waits for it */
+    EX_RUNDOWN_REF Rundown;
 } PL330DMA_THREAD_CALLBACK, *PPL330DMA_THREAD_CALLBACK;
 
 #define MAX_NOTIF_EVENTS 16
@@ -80,13 +87,20 @@ typedef struct _PL330DMA_THREAD {
     BOOLEAN Free;
     /* Parent Device */
     struct _PL330DMA_CONTEXT *Device;
-    /* Only 1 at a time */
-    PL330DMA_REQ Req[1];
+    /* One runs while the other is staged */
+    PL330DMA_REQ Req[2];
+    /* Index of the last enqueued request */
+    int LastEnqueued;
+
+    /* Packed, the first NumCallbacks entries are in use */
+    PPL330DMA_THREAD_CALLBACK registeredCallbacks[MAX_NOTIF_EVENTS];
+    UINT8 NumCallbacks;
 
-    PL330DMA_THREAD_CALLBACK registeredCallbacks[MAX_NOTIF_EVENTS];
+    /* SEVs taken by the ISR and not yet dispatched by the DPC */
+    volatile LONG PendingEvents;
 
     /* Index of last submitted request (or -1 if stopped) */
-    BOOLEAN ReqRunning;
+    int ReqRunning;
 } PL330DMA_THREAD, *PPL330DMA_THREAD;
 
 typedef struct _PL330DMA_CONTEXT
@@ -104,9 +118,12 @@ typedef struct _PL330DMA_CONTEXT
 
     PL330DMA_CONFIG Config;
 
-    //Size of MicroCode buffers for each channel
+    //Size of MicroCode buffers for each channel, split between its 2 reqs
     unsigned MCBufSz;
 
+    //Protects the request queues and the debug instruction registers
+    KSPIN_LOCK Lock;
+
     //CPU address of MicroCode buffer
     UINT8 *MCodeCPU;
 
@@ -115,8 +132,8 @@ typedef struct _PL330DMA_CONTEXT
     //Pointer to the Manager thread
     PPL330DMA_THREAD Manager;
 
-    //Interrupt Context
-    UINT32 irqLastEvents;
+    //Interrupt Context, events accumulated by the ISR until the DPC takes them
+    volatile LONG irqLastEvents;
 } PL330DMA_CONTEXT, *PPL330DMA_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(PL330DMA_CONTEXT, GetDeviceContext)
@@ -144,8 +161,12 @@ void ReadDmacConfiguration(PPL330DMA_CONTEXT pDevice);
 NTSTATUS AllocResources(PPL330DMA_CONTEXT pDevice);
 void FreeResources(PPL330DMA_CONTEXT pDevice);
 
+void _retire(PPL330DMA_THREAD Thread);
 void _stop(PPL330DMA_THREAD Thread);
 BOOLEAN _start(PPL330DMA_THREAD Thread);
+PPL330DMA_REQ _get_req(PPL330DMA_THREAD Thread);
+BOOLEAN _submit(PPL330DMA_THREAD Thread, PPL330DMA_REQ pReq);
+void _complete(PPL330DMA_THREAD Thread);
 
 PPL330DMA_THREAD GetHandle(PPL330DMA_CONTEXT pDevice, int Idx);
 BOOLEAN FreeHandle(PPL330DMA_CONTEXT pDevice, PPL330DMA_THREAD Thread);
@@ -160,6 +181,28 @@ NTSTATUS SubmitAudioDMA(
     UINT32 len, UINT32 periodLen
 );
 
+NTSTATUS SubmitDMA(
+    PPL330DMA_CONTEXT pDevice,
+    PPL330DMA_THREAD Thread,
+    BOOLEAN fromDevice,
+    PMDL pMDL,
+    UINT32 devAddr
+);
+
+NTSTATUS SubmitCopyDMA(
+    PPL330DMA_CONTEXT pDevice,
+    PPL330DMA_THREAD Thread,
+    UINT32 srcAddr, UINT32 dstAddr,
+    UINT32 len
+);
+
+NTSTATUS SubmitFillDMA(
+    PPL330DMA_CONTEXT pDevice,
+    PPL330DMA_THREAD Thread,
+    UINT32 dstAddr, UINT8 value,
+    UINT32 len
+);
+
 NTSTATUS RegisterNotificationCallback(
     PPL330DMA_CONTEXT pDevice,
     PPL330DMA_THREAD Thread,
@@ -217,6 +217,7 @@ static int _loop_cyclic(BOOLEAN dryRun,
 	residue = pxs->numPeriods % periods;
 
 	/* forever loop */
+	/* keep SAR/DAR right after MOV CCR, SubmitAudioDMA patches them on reuse */
 	off += _emit_MOV(dryRun, &buf[off], SAR, pxs->srcAddr);
 	off += _emit_MOV(dryRun, &buf[off], DAR, pxs->dstAddr);
 
@@ -245,6 +246,34 @@ static int _loop_cyclic(BOOLEAN dryRun,
 	return off;
 }
 
+/*
+ * A free req whose microcode is still the cyclic program for pxs, so only
+ * the SAR/DAR immediates need rewriting. NULL if there is none.
+ */
+static PPL330DMA_REQ _get_cached_req(PPL330DMA_THREAD Thread, PXFER_SPEC pxs)
+{
+	/* Same queueing rules as a fresh slot */
+	if (!_get_req(Thread))
+		return NULL;
+
+	for (int i = 0; i < 2; i++) {
+		PPL330DMA_REQ pReq = &Thread->Req[i];
+		PXFER_SPEC cached = &pReq->Xfer;
+
+		if (pReq->InUse || pReq->EndOff || !cached->numPeriods)
+			continue;
+
+		if (cached->ccr == pxs->ccr &&
+			cached->toDevice == pxs->toDevice &&
+			cached->Peripheral == pxs->Peripheral &&
+			cached->numPeriods == pxs->numPeriods &&
+			cached->periodBytes == pxs->periodBytes)
+			return pReq;
+	}
+
+	return NULL;
+}
+
 NTSTATUS SubmitAudioDMA(
 	PPL330DMA_CONTEXT pDevice,
 	PPL330DMA_THREAD Thread,
@@ -271,14 +300,6 @@ NTSTATUS SubmitAudioDMA(
 	ccr |= (CCTRL0 << CC_DSTCCTRL_SHFT);
 	ccr |= (SWAP_NO << CC_SWAP_SHFT);
 
-	PL330_DBGMC_START(Thread->Req[0].MCbus.LowPart);
-
-	UINT8* buf = Thread->Req[0].MCcpu;
-
-	//DMAMOV CCR, ccr
-	int off = 0;
-	off += _emit_MOV(FALSE, &buf[off], CCR, ccr);
-
 	XFER_SPEC pxs = { 0 };
 	pxs.ccr = ccr;
 	pxs.involvesDevice = TRUE;
@@ -290,13 +311,433 @@ NTSTATUS SubmitAudioDMA(
 	pxs.dstAddr = dstAddr;
 	pxs.periodBytes = periodLen;
 
-	Thread->Req[0].Xfer = pxs;
-
 	UINT32 bursts = BYTE_TO_BURST(periodLen, ccr);
-	off += _loop_cyclic(FALSE, &buf[off], bursts, &pxs, Thread->Id);
 
-	BOOLEAN started = _start(Thread);
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
+
+	PPL330DMA_REQ pReq = _get_cached_req(Thread, &pxs);
+	if (pReq) {
+		//Same program as last time, just point it at the new buffer
+		UINT8* buf = pReq->MCcpu;
+
+		_emit_MOV(FALSE, &buf[SZ_DMAMOV], SAR, srcAddr);
+		_emit_MOV(FALSE, &buf[2 * SZ_DMAMOV], DAR, dstAddr);
+	}
+	else {
+		pReq = _get_req(Thread);
+		if (!pReq) {
+			KeReleaseSpinLock(&pDevice->Lock, irql);
+			return STATUS_DEVICE_BUSY;
+		}
+
+		UINT8* buf = pReq->MCcpu;
+
+		//Dry run, nothing is written; the program has to fit in one req slot
+		int size = _emit_MOV(TRUE, buf, CCR, ccr);
+		size += _loop_cyclic(TRUE, &buf[size], bursts, &pxs, Thread->Id);
+		if ((unsigned)size > pDevice->MCBufSz / 2) {
+			KeReleaseSpinLock(&pDevice->Lock, irql);
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+
+		PL330_DBGMC_START(pReq->MCbus.LowPart);
+
+		//DMAMOV CCR, ccr
+		int off = 0;
+		off += _emit_MOV(FALSE, &buf[off], CCR, ccr);
+		off += _loop_cyclic(FALSE, &buf[off], bursts, &pxs, Thread->Id);
+	}
+
+	pReq->Xfer = pxs;
+	pReq->EndOff = 0;
+	pReq->Mdl = NULL;
+
+	BOOLEAN started = _submit(Thread, pReq);
+
+	KeReleaseSpinLock(&pDevice->Lock, irql);
+
 	if (started)
 		return STATUS_SUCCESS;
 	return STATUS_UNSUCCESSFUL;
-}
\ No newline at end of file
+}
+
+/*
+ * transfer 'bursts' bursts with nested loops so the size of the
+ * microcode doesn't depend on the length of the transfer.
+ */
+static int _loop_bursts(BOOLEAN dryRun, UINT8 buf[],
+	PXFER_SPEC pxs, unsigned long bursts)
+{
+	unsigned int lcnt0, lcnt1, ljmp0 = 0, ljmp1;
+	int off = 0;
+	struct _arg_LPEND lpend;
+
+	while (bursts) {
+		lcnt1 = bursts > 256 ? 256 : bursts;
+		lcnt0 = bursts / lcnt1;
+		if (lcnt0 > 256)
+			lcnt0 = 256;
+
+		/* loop0 */
+		if (lcnt0 > 1) {
+			off += _emit_LP(dryRun, &buf[off], 0, lcnt0);
+			ljmp0 = off;
+		}
+
+		/* loop1 */
+		off += _emit_LP(dryRun, &buf[off], 1, lcnt1);
+		ljmp1 = off;
+		off += _bursts(dryRun, &buf[off], pxs, 1);
+		lpend.cond = ALWAYS;
+		lpend.forever = FALSE;
+		lpend.loop = 1;
+		lpend.bjump = off - ljmp1;
+		off += _emit_LPEND(dryRun, &buf[off], &lpend);
+
+		if (lcnt0 > 1) {
+			lpend.cond = ALWAYS;
+			lpend.forever = FALSE;
+			lpend.loop = 0;
+			lpend.bjump = off - ljmp0;
+			off += _emit_LPEND(dryRun, &buf[off], &lpend);
+		}
+
+		bursts -= lcnt0 * lcnt1;
+	}
+
+	return off;
+}
+
+/* one physically contiguous run of the memory side */
+static int _run(BOOLEAN dryRun, UINT8 buf[],
+	PXFER_SPEC pxs, UINT32 addr, UINT32 len)
+{
+	int off = 0, num_dregs;
+
+	off += _emit_MOV(dryRun, &buf[off], pxs->toDevice ? SAR : DAR, addr);
+	off += _loop_bursts(dryRun, &buf[off], pxs, BYTE_TO_BURST(len, pxs->ccr));
+
+	num_dregs = BYTE_MOD_BURST_LEN(len, pxs->ccr);
+
+	if (num_dregs) {
+		off += _dregs(dryRun, &buf[off], pxs, num_dregs);
+		off += _emit_MOV(dryRun, &buf[off], CCR, pxs->ccr);
+	}
+
+	return off;
+}
+
+/*
+ * walk the pages of the MDL chain and emit a run for each physically
+ * contiguous range. returns -1 if a page isn't reachable by the DMAC.
+ */
+static int _mdl_runs(BOOLEAN dryRun, UINT8 buf[],
+	PXFER_SPEC pxs, PMDL pMDL)
+{
+	UINT64 runAddr = 0, runLen = 0;
+	int off = 0;
+
+	for (PMDL mdl = pMDL; mdl; mdl = mdl->Next) {
+		PPFN_NUMBER pfns = MmGetMdlPfnArray(mdl);
+		ULONG pageOff = MmGetMdlByteOffset(mdl);
+		ULONG remaining = MmGetMdlByteCount(mdl);
+
+		for (ULONG i = 0; remaining; i++) {
+			UINT64 addr = ((UINT64)pfns[i] << PAGE_SHIFT) + pageOff;
+			ULONG len = min(PAGE_SIZE - pageOff, remaining);
+
+			if (addr + len - 1 > MAXUINT32)
+				return -1;
+
+			if (runLen && addr == runAddr + runLen) {
+				runLen += len;
+			}
+			else {
+				if (runLen)
+					off += _run(dryRun, &buf[off], pxs, (UINT32)runAddr, (UINT32)runLen);
+				runAddr = addr;
+				runLen = len;
+			}
+
+			remaining -= len;
+			pageOff = 0;
+		}
+	}
+
+	if (runLen)
+		off += _run(dryRun, &buf[off], pxs, (UINT32)runAddr, (UINT32)runLen);
+
+	return off;
+}
+
+/*
+ * one-shot program: fixed peripheral address on one side, the MDL's runs
+ * on the other, then signal the event once the writes have landed.
+ */
+static int _mdl_program(BOOLEAN dryRun, UINT8 buf[],
+	PXFER_SPEC pxs, PMDL pMDL, UINT32 devAddr, int ev)
+{
+	int off = 0, runs;
+
+	off += _emit_MOV(dryRun, &buf[off], CCR, pxs->ccr);
+	off += _emit_MOV(dryRun, &buf[off], pxs->toDevice ? DAR : SAR, devAddr);
+
+	runs = _mdl_runs(dryRun, &buf[off], pxs, pMDL);
+	if (runs < 0)
+		return -1;
+	off += runs;
+
+	off += _emit_WMB(dryRun, &buf[off]);
+	off += _emit_SEV(dryRun, &buf[off], ev);
+	off += _emit_END(dryRun, &buf[off]);
+
+	return off;
+}
+
+/*
+ * One-shot transfer between a locked MDL chain and the peripheral FIFO
+ * at devAddr. The thread's event fires once the last byte has moved.
+ */
+NTSTATUS SubmitDMA(
+	PPL330DMA_CONTEXT pDevice,
+	PPL330DMA_THREAD Thread,
+	BOOLEAN fromDevice,
+	PMDL pMDL,
+	UINT32 devAddr
+) {
+	UINT32 ccr = fromDevice ? CC_DSTINC : CC_SRCINC;
+
+	ccr |= CC_SRCNS | CC_DSTNS;
+
+	UINT32 addrWidth = 4;
+	UINT32 maxBurst = 8;
+
+	//port width
+	ccr |= ((maxBurst - 1) << CC_SRCBRSTLEN_SHFT);
+	ccr |= ((maxBurst - 1) << CC_DSTBRSTLEN_SHFT);
+
+	ULONG burstSz = 0;
+	_BitScanForward(&burstSz, addrWidth);
+	ccr |= (burstSz << CC_SRCBRSTSIZE_SHFT);
+	ccr |= (burstSz << CC_DSTBRSTSIZE_SHFT);
+	ccr |= (CCTRL0 << CC_SRCCCTRL_SHFT);
+	ccr |= (CCTRL0 << CC_DSTCCTRL_SHFT);
+	ccr |= (SWAP_NO << CC_SWAP_SHFT);
+
+	UINT32 totalLen = 0;
+	for (PMDL mdl = pMDL; mdl; mdl = mdl->Next) {
+		//Each beat moves addrWidth bytes, so runs can't split one
+		if ((MmGetMdlByteOffset(mdl) | MmGetMdlByteCount(mdl)) & (addrWidth - 1))
+			return STATUS_INVALID_PARAMETER;
+		if (totalLen + MmGetMdlByteCount(mdl) < totalLen)
+			return STATUS_INVALID_PARAMETER;
+		totalLen += MmGetMdlByteCount(mdl);
+	}
+	if (!totalLen)
+		return STATUS_INVALID_PARAMETER;
+
+	XFER_SPEC pxs = { 0 };
+	pxs.ccr = ccr;
+	pxs.involvesDevice = TRUE;
+	pxs.toDevice = !fromDevice;
+	pxs.Peripheral = Thread->Id;
+
+	pxs.numPeriods = 1;
+	pxs.srcAddr = fromDevice ? devAddr : 0;
+	pxs.dstAddr = fromDevice ? 0 : devAddr;
+	pxs.periodBytes = totalLen;
+
+	//Size the program first (dry run, nothing is written); pages above 4GB
+	//can't be reached by the DMAC
+	int size = _mdl_program(TRUE, Thread->Req[0].MCcpu, &pxs, pMDL, devAddr, Thread->ev);
+	if (size < 0)
+		return STATUS_INVALID_PARAMETER;
+	if ((unsigned)size > pDevice->MCBufSz / 2)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	for (PMDL mdl = pMDL; mdl; mdl = mdl->Next)
+		KeFlushIoBuffers(mdl, fromDevice, TRUE);
+
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
+
+	PPL330DMA_REQ pReq = _get_req(Thread);
+	if (!pReq) {
+		KeReleaseSpinLock(&pDevice->Lock, irql);
+		return STATUS_DEVICE_BUSY;
+	}
+
+	PL330_DBGMC_START(pReq->MCbus.LowPart);
+
+	_mdl_program(FALSE, pReq->MCcpu, &pxs, pMDL, devAddr, Thread->ev);
+
+	pReq->Xfer = pxs;
+	pReq->EndOff = size - SZ_DMAEND;
+	pReq->Mdl = fromDevice ? pMDL : NULL;
+
+	BOOLEAN started = _submit(Thread, pReq);
+
+	KeReleaseSpinLock(&pDevice->Lock, irql);
+
+	if (started)
+		return STATUS_SUCCESS;
+	return STATUS_UNSUCCESSFUL;
+}
+
+/*
+ * mem-to-mem ccr: widest beat the bus allows that divides align
+ * (src | dst | len), and the longest burst that still leaves every
+ * channel its share of the MFIFO.
+ */
+static UINT32 _memtomem_ccr(PPL330DMA_CONTEXT pDevice, UINT32 align, BOOLEAN fixedSrc)
+{
+	UINT32 ccr = CC_DSTINC;
+
+	if (!fixedSrc)
+		ccr |= CC_SRCINC;
+
+	ccr |= CC_SRCNS | CC_DSTNS;
+
+	UINT32 busBytes = pDevice->Config.DataBusWidth / 8;
+	UINT32 addrWidth = busBytes;
+	while (addrWidth > 1 && (align & (addrWidth - 1)))
+		addrWidth /= 2;
+
+	UINT32 maxBurst = busBytes * pDevice->Config.DataBufDepth / pDevice->Config.NumChan;
+	maxBurst /= addrWidth;
+	if (maxBurst > PL330_MAX_BURST)
+		maxBurst = PL330_MAX_BURST;
+	if (maxBurst < 1)
+		maxBurst = 1;
+
+	//port width
+	ccr |= ((maxBurst - 1) << CC_SRCBRSTLEN_SHFT);
+	ccr |= ((maxBurst - 1) << CC_DSTBRSTLEN_SHFT);
+
+	ULONG burstSz = 0;
+	_BitScanForward(&burstSz, addrWidth);
+	ccr |= (burstSz << CC_SRCBRSTSIZE_SHFT);
+	ccr |= (burstSz << CC_DSTBRSTSIZE_SHFT);
+	ccr |= (CCTRL0 << CC_SRCCCTRL_SHFT);
+	ccr |= (CCTRL0 << CC_DSTCCTRL_SHFT);
+	ccr |= (SWAP_NO << CC_SWAP_SHFT);
+
+	return ccr;
+}
+
+static int _memtomem_program(BOOLEAN dryRun, UINT8 buf[],
+	PXFER_SPEC pxs, int ev)
+{
+	int off = 0, num_dregs;
+
+	off += _emit_MOV(dryRun, &buf[off], CCR, pxs->ccr);
+	off += _emit_MOV(dryRun, &buf[off], SAR, pxs->srcAddr);
+	off += _emit_MOV(dryRun, &buf[off], DAR, pxs->dstAddr);
+
+	off += _loop_bursts(dryRun, &buf[off], pxs,
+		BYTE_TO_BURST(pxs->periodBytes, pxs->ccr));
+
+	num_dregs = BYTE_MOD_BURST_LEN(pxs->periodBytes, pxs->ccr);
+	if (num_dregs)
+		off += _dregs(dryRun, &buf[off], pxs, num_dregs);
+
+	off += _emit_WMB(dryRun, &buf[off]);
+	off += _emit_SEV(dryRun, &buf[off], ev);
+	off += _emit_END(dryRun, &buf[off]);
+
+	return off;
+}
+
+/*
+ * The fill pattern lives in the channel's (uncached) microcode buffer,
+ * right after END, and is read from a fixed source address.
+ */
+static NTSTATUS _submit_memtomem(
+	PPL330DMA_CONTEXT pDevice,
+	PPL330DMA_THREAD Thread,
+	PXFER_SPEC pxs,
+	const UINT8* fill
+) {
+	int size = _memtomem_program(TRUE, Thread->Req[0].MCcpu, pxs, Thread->ev);
+	int fillOff = (size + 7) & ~7;
+	if ((unsigned)(fill ? fillOff + 8 : size) > pDevice->MCBufSz / 2)
+		return STATUS_INSUFFICIENT_RESOURCES;
+
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
+
+	PPL330DMA_REQ pReq = _get_req(Thread);
+	if (!pReq) {
+		KeReleaseSpinLock(&pDevice->Lock, irql);
+		return STATUS_DEVICE_BUSY;
+	}
+
+	UINT8* buf = pReq->MCcpu;
+
+	if (fill) {
+		RtlCopyMemory(&buf[fillOff], fill, 8);
+		pxs->srcAddr = pReq->MCbus.LowPart + fillOff;
+	}
+
+	PL330_DBGMC_START(pReq->MCbus.LowPart);
+
+	_memtomem_program(FALSE, buf, pxs, Thread->ev);
+
+	pReq->Xfer = *pxs;
+	pReq->EndOff = size - SZ_DMAEND;
+	pReq->Mdl = NULL;
+
+	BOOLEAN started = _submit(Thread, pReq);
+
+	KeReleaseSpinLock(&pDevice->Lock, irql);
+
+	if (started)
+		return STATUS_SUCCESS;
+	return STATUS_UNSUCCESSFUL;
+}
+
+NTSTATUS SubmitCopyDMA(
+	PPL330DMA_CONTEXT pDevice,
+	PPL330DMA_THREAD Thread,
+	UINT32 srcAddr, UINT32 dstAddr,
+	UINT32 len
+) {
+	if (!len)
+		return STATUS_INVALID_PARAMETER;
+
+	XFER_SPEC pxs = { 0 };
+	pxs.ccr = _memtomem_ccr(pDevice, srcAddr | dstAddr | len, FALSE);
+	pxs.involvesDevice = FALSE;
+
+	pxs.numPeriods = 1;
+	pxs.srcAddr = srcAddr;
+	pxs.dstAddr = dstAddr;
+	pxs.periodBytes = len;
+
+	return _submit_memtomem(pDevice, Thread, &pxs, NULL);
+}
+
+NTSTATUS SubmitFillDMA(
+	PPL330DMA_CONTEXT pDevice,
+	PPL330DMA_THREAD Thread,
+	UINT32 dstAddr, UINT8 value,
+	UINT32 len
+) {
+	UINT8 fill[8];
+
+	if (!len)
+		return STATUS_INVALID_PARAMETER;
+
+	RtlFillMemory(fill, sizeof(fill), value);
+
+	XFER_SPEC pxs = { 0 };
+	pxs.ccr = _memtomem_ccr(pDevice, dstAddr | len | sizeof(fill), TRUE);
+	pxs.involvesDevice = FALSE;
+
+	pxs.numPeriods = 1;
+	pxs.dstAddr = dstAddr;
+	pxs.periodBytes = len;
+
+	return _submit_memtomem(pDevice, Thread, &pxs, fill);
+}
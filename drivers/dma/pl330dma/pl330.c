@@ -480,10 +480,14 @@ IN PWDFDEVICE_INIT DeviceInit
 		Pl330DMAInterface.StopDMA = StopThread;
 		Pl330DMAInterface.GetThreadRegisters = GetThreadRegisters;
 		Pl330DMAInterface.SubmitAudioDMA = SubmitAudioDMA;
+		Pl330DMAInterface.SubmitDMA = SubmitDMA;
 
 		Pl330DMAInterface.RegisterNotificationCallback = RegisterNotificationCallback;
 		Pl330DMAInterface.UnregisterNotificationCallback = UnregisterNotificationCallback;
 
+		Pl330DMAInterface.SubmitCopyDMA = SubmitCopyDMA;
+		Pl330DMAInterface.SubmitFillDMA = SubmitFillDMA;
+
 		WDF_QUERY_INTERFACE_CONFIG_INIT(&qiConfig,
 			(PINTERFACE)&Pl330DMAInterface,
 			&GUID_PL330DMA_INTERFACE_STANDARD,
@@ -9,16 +9,22 @@ static void ResetThread(PPL330DMA_THREAD Thread) {
 	Thread->Req[0].MCcpu = pDevice->MCodeCPU + (Thread->Id * pDevice->MCBufSz);
 	Thread->Req[0].MCbus = MmGetPhysicalAddress(Thread->Req[0].MCcpu);
 	RtlZeroMemory(&Thread->Req[0].Xfer, sizeof(XFER_SPEC));
+	Thread->Req[0].InUse = FALSE;
+	Thread->Req[0].Mdl = NULL;
 
-	/*Thread->Req[1].MCcpu = Thread->Req[0].MCcpu + pDevice->MCBufSz / 2;
+	Thread->Req[1].MCcpu = Thread->Req[0].MCcpu + pDevice->MCBufSz / 2;
 	Thread->Req[1].MCbus = MmGetPhysicalAddress(Thread->Req[1].MCcpu);
-	Thread->Req[1].Xfer = NULL;*/
+	RtlZeroMemory(&Thread->Req[1].Xfer, sizeof(XFER_SPEC));
+	Thread->Req[1].InUse = FALSE;
+	Thread->Req[1].Mdl = NULL;
 
-	for (int j = 0; j < MAX_NOTIF_EVENTS; j++) {
-		Thread->registeredCallbacks[j].InUse = FALSE;
-	}
+	/* So the first request goes to Req[0] */
+	Thread->LastEnqueued = 1;
+
+	Thread->NumCallbacks = 0;
+	Thread->PendingEvents = 0;
 
-	Thread->ReqRunning = FALSE;
+	Thread->ReqRunning = -1;
 }
 
 static NTSTATUS AllocThreads(PPL330DMA_CONTEXT pDevice) {
@@ -55,6 +61,8 @@ NTSTATUS AllocResources(PPL330DMA_CONTEXT pDevice) {
 	//Use default MC Buffer Size
 	pDevice->MCBufSz = MCODE_BUFF_PER_REQ * 2;
 
+	KeInitializeSpinLock(&pDevice->Lock);
+
 	//Allocate MicroCode buffer for 'chans' Channel threads
 
 	PHYSICAL_ADDRESS ZeroAddr = { 0 };
@@ -80,6 +88,14 @@ void FreeResources(PPL330DMA_CONTEXT pDevice) {
 
 		for (UINT32 i = 0; i < pDevice->Config.NumChan; i++) {
 			_stop(pDevice->Channels);
+
+			//Callbacks the client never unregistered
+			PPL330DMA_THREAD Thread = &pDevice->Channels[i];
+			while (Thread->NumCallbacks) {
+				PPL330DMA_THREAD_CALLBACK callback = Thread->registeredCallbacks[--Thread->NumCallbacks];
+				InterlockedDecrement(&callback->Fdo->ReferenceCount);
+				ExFreePoolWithTag(callback, PL330DMA_POOL_TAG);
+			}
 		}
 
 		//Free Channel Memory
@@ -108,10 +124,22 @@ PPL330DMA_THREAD GetHandle(PPL330DMA_CONTEXT pDevice, int Idx) {
 }
 
 void StopThread(PPL330DMA_CONTEXT pDevice, PPL330DMA_THREAD Thread) {
-	UNREFERENCED_PARAMETER(pDevice);
 	if (!Thread)
 		return;
+
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
+
 	_stop(Thread);
+	_retire(Thread);
+
+	//Drop anything still queued behind it, it never ran
+	Thread->Req[0].InUse = FALSE;
+	Thread->Req[0].Mdl = NULL;
+	Thread->Req[1].InUse = FALSE;
+	Thread->Req[1].Mdl = NULL;
+
+	KeReleaseSpinLock(&pDevice->Lock, irql);
 }
 
 void GetThreadRegisters(PPL330DMA_CONTEXT pDevice, PPL330DMA_THREAD Thread, UINT32* cpc, UINT32* sa, UINT32* da) {
@@ -132,7 +160,7 @@ BOOLEAN FreeHandle(PPL330DMA_CONTEXT pDevice, PPL330DMA_THREAD Thread) {
 	UNREFERENCED_PARAMETER(pDevice);
 	if (!Thread)
 		return FALSE;
-	if (Thread->ReqRunning) {
+	if (Thread->ReqRunning != -1 || Thread->Req[0].InUse || Thread->Req[1].InUse) {
 		return FALSE;
 	}
 	Thread->Free = TRUE;
@@ -145,52 +173,76 @@ NTSTATUS RegisterNotificationCallback(
 	PDEVICE_OBJECT Fdo,
 	PDMA_NOTIFICATION_CALLBACK NotificationCallback,
 	PVOID CallbackContext) {
-	UNREFERENCED_PARAMETER(pDevice);
 	if (!Thread)
 		return STATUS_INVALID_PARAMETER;
 
+	PPL330DMA_THREAD_CALLBACK callback = ExAllocatePoolZero(NonPagedPool, sizeof(*callback), PL330DMA_POOL_TAG);
+	if (!callback)
+		return STATUS_NO_MEMORY;
+
+	callback->Fdo = Fdo;
+	callback->NotificationCallback = NotificationCallback;
+	callback->CallbackContext = CallbackContext;
+	ExInitializeRundownProtection(&callback->Rundown);
+
 	BOOLEAN registered = FALSE;
 
-	for (int i = 0; i < MAX_NOTIF_EVENTS; i++) {
-		if (Thread->registeredCallbacks[i].InUse)
-			continue;
-		Thread->registeredCallbacks[i].InUse = TRUE;
-		Thread->registeredCallbacks[i].Fdo = Fdo;
-		Thread->registeredCallbacks[i].NotificationCallback = NotificationCallback;
-		Thread->registeredCallbacks[i].CallbackContext = CallbackContext;
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
 
+	if (Thread->NumCallbacks < MAX_NOTIF_EVENTS) {
+		Thread->registeredCallbacks[Thread->NumCallbacks++] = callback;
 		InterlockedIncrement(&Fdo->ReferenceCount);
-
 		registered = TRUE;
-		break;
 	}
 
-	return registered ? STATUS_SUCCESS : STATUS_INSUFFICIENT_RESOURCES;
+	KeReleaseSpinLock(&pDevice->Lock, irql);
+
+	if (!registered) {
+		ExFreePoolWithTag(callback, PL330DMA_POOL_TAG);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	return STATUS_SUCCESS;
 }
 
+/* PASSIVE_LEVEL, and not from the callback itself: waits for a running DPC to return from it */
 NTSTATUS UnregisterNotificationCallback(
 	PPL330DMA_CONTEXT pDevice,
 	PPL330DMA_THREAD Thread,
 	PDMA_NOTIFICATION_CALLBACK NotificationCallback,
 	PVOID CallbackContext) {
-	UNREFERENCED_PARAMETER(pDevice);
 	if (!Thread)
 		return STATUS_INVALID_PARAMETER;
 
-	BOOLEAN registered = FALSE;
+	PPL330DMA_THREAD_CALLBACK callback = NULL;
 
-	for (int i = 0; i < MAX_NOTIF_EVENTS; i++) {
-		if (Thread->registeredCallbacks[i].InUse &&
-			Thread->registeredCallbacks[i].NotificationCallback != NotificationCallback &&
-			Thread->registeredCallbacks[i].CallbackContext != CallbackContext)
+	KIRQL irql;
+	KeAcquireSpinLock(&pDevice->Lock, &irql);
+
+	for (int i = 0; i < Thread->NumCallbacks; i++) {
+		if (Thread->registeredCallbacks[i]->NotificationCallback != NotificationCallback ||
+			Thread->registeredCallbacks[i]->CallbackContext != CallbackContext)
 			continue;
 
-		InterlockedDecrement(&Thread->registeredCallbacks[i].Fdo->ReferenceCount);
+		callback = Thread->registeredCallbacks[i];
 
-		RtlZeroMemory(&Thread->registeredCallbacks[i], sizeof(Thread->registeredCallbacks[i]));
-		registered = TRUE;
+		//Keep the table packed
+		Thread->registeredCallbacks[i] = Thread->registeredCallbacks[--Thread->NumCallbacks];
+		Thread->registeredCallbacks[Thread->NumCallbacks] = NULL;
 		break;
 	}
 
-	return registered ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER;
-}
\ No newline at end of file
+	KeReleaseSpinLock(&pDevice->Lock, irql);
+
+	if (!callback)
+		return STATUS_INVALID_PARAMETER;
+
+	//No new DPC can see it now; wait out one that already took it
+	ExWaitForRundownProtectionRelease(&callback->Rundown);
+
+	InterlockedDecrement(&callback->Fdo->ReferenceCount);
+	ExFreePoolWithTag(callback, PL330DMA_POOL_TAG);
+
+	return STATUS_SUCCESS;
+}
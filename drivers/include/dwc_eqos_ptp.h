@@ -0,0 +1,69 @@
+#ifndef _DWC_EQOS_PTP_INTERFACE_H
+#define _DWC_EQOS_PTP_INTERFACE_H
+
+/*
+IEEE 1588 hardware clock interface exposed by dwc_eqos (via IRP_MN_QUERY_INTERFACE)
+when the *PtpHardwareTimestamp keyword is enabled.
+
+Times are nanoseconds since 1970-01-01 (PTP epoch). Functions may be called at
+IRQL <= DISPATCH_LEVEL. They fail with STATUS_DEVICE_NOT_READY while the device is
+not in D0 and with STATUS_NOT_SUPPORTED if hardware timestamping is disabled.
+*/
+
+typedef
+NTSTATUS
+(*PDWCEQOS_PTP_GET_TIME)(
+    IN PVOID Context,
+    OUT UINT64* TimeNs
+    );
+
+typedef
+NTSTATUS
+(*PDWCEQOS_PTP_SET_TIME)(
+    IN PVOID Context,
+    IN UINT64 TimeNs
+    );
+
+// Steps the clock by DeltaNs (coarse update).
+typedef
+NTSTATUS
+(*PDWCEQOS_PTP_ADJUST_TIME)(
+    IN PVOID Context,
+    IN INT64 DeltaNs
+    );
+
+// Sets the clock rate to nominal + Ppb parts per billion (fine update).
+typedef
+NTSTATUS
+(*PDWCEQOS_PTP_ADJUST_FREQUENCY)(
+    IN PVOID Context,
+    IN INT32 Ppb
+    );
+
+// Gets the hardware timestamp of a PTPv2 event message (Sync, Delay_Req, Pdelay_Req,
+// Pdelay_Resp) sent or received by the adapter, identified by the messageType and
+// sequenceId fields of its PTP header. Each timestamp can be retrieved once. Only the
+// most recent 16 timestamps per direction are kept. STATUS_NOT_FOUND if there is no
+// such timestamp (yet).
+typedef
+NTSTATUS
+(*PDWCEQOS_PTP_GET_PACKET_TIMESTAMP)(
+    IN PVOID Context,
+    IN BOOLEAN Transmit,
+    IN UINT8 MessageType,
+    IN UINT16 SequenceId,
+    OUT UINT64* TimeNs
+    );
+
+DEFINE_GUID(GUID_DWCEQOS_PTP_INTERFACE_STANDARD,
+    0x251c0e99, 0xe13a, 0x47da, 0xa3, 0xc9, 0x95, 0x29, 0x89, 0xf7, 0x14, 0x0b);
+
+typedef struct _DWCEQOS_PTP_INTERFACE_STANDARD {
+    INTERFACE                           InterfaceHeader;
+    PDWCEQOS_PTP_GET_TIME               GetTime;
+    PDWCEQOS_PTP_SET_TIME               SetTime;
+    PDWCEQOS_PTP_ADJUST_TIME            AdjustTime;
+    PDWCEQOS_PTP_ADJUST_FREQUENCY       AdjustFrequency;
+    PDWCEQOS_PTP_GET_PACKET_TIMESTAMP   GetPacketTimestamp;
+} DWCEQOS_PTP_INTERFACE_STANDARD, * PDWCEQOS_PTP_INTERFACE_STANDARD;
+#endif
@@ -50,6 +50,14 @@ NTSTATUS
     IN UINT32 periodLen
     );
 
+// One-shot transfer between the pages of a locked MDL chain and the peripheral
+// FIFO at devAddr. Page runs must be below 4GB and start/end on 4 byte boundaries.
+// The channel's notification callbacks run once the transfer has completed; the
+// MDL must stay locked until then. For device-to-memory transfers the buffer is
+// flushed again before the callbacks run.
+// A channel holds up to 2 requests: a submission made while one is running is
+// started as soon as that one ends; a third fails with STATUS_DEVICE_BUSY. So does
+// anything submitted behind a SubmitAudioDMA program, which runs until StopDMA.
 typedef
 NTSTATUS
 (*PSUBMIT_DMA) (
@@ -57,7 +65,32 @@ NTSTATUS
     IN HANDLE Handle,
     IN BOOLEAN fromDevice,
     IN PMDL pMDL,
-    IN UINT32 dstAddr
+    IN UINT32 devAddr
+    );
+
+// Asynchronous memory-to-memory copy / fill between physical addresses below 4GB.
+// Any alignment works; the beat size is picked from the alignment of the addresses
+// and length. The copy runs front to back, so the ranges must not overlap. The caller
+// owns cache maintenance. The channel's notification callbacks run once the transfer
+// has completed. Queued the same way as SubmitDMA.
+typedef
+NTSTATUS
+(*PSUBMIT_COPY_DMA) (
+    IN PVOID Context,
+    IN HANDLE Handle,
+    IN UINT32 srcAddr,
+    IN UINT32 dstAddr,
+    IN UINT32 len
+    );
+
+typedef
+NTSTATUS
+(*PSUBMIT_FILL_DMA) (
+    IN PVOID Context,
+    IN HANDLE Handle,
+    IN UINT32 dstAddr,
+    IN UINT8 value,
+    IN UINT32 len
     );
 
 typedef
@@ -89,8 +122,10 @@ typedef struct _PL330DMA_INTERFACE_STANDARD {
     PSTOP_DMA                           StopDMA;
     PGET_THREAD_REGISTERS               GetThreadRegisters;
     PSUBMIT_AUDIO_DMA                   SubmitAudioDMA;
-    PSUBMIT_DMA                         SubmitDMA; //reserved for future use
+    PSUBMIT_DMA                         SubmitDMA;
     PREGISTER_NOTIFICATION_CALLBACK     RegisterNotificationCallback;
     PUNREGISTER_NOTIFICATION_CALLBACK   UnregisterNotificationCallback;
+    PSUBMIT_COPY_DMA                    SubmitCopyDMA;
+    PSUBMIT_FILL_DMA                    SubmitFillDMA;
 } PL330DMA_INTERFACE_STANDARD, * PPL330DMA_INTERFACE_STANDARD;
 #endif
\ No newline at end of file
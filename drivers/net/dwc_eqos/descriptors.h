@@ -21,6 +21,14 @@ enum TxChecksumInsertion : UINT16
     TxChecksumInsertionEnabledIncludingPseudo = 3,
 };
 
+enum TxVlanTagControl : UINT16
+{
+    TxVlanTagControlNone = 0,
+    TxVlanTagControlRemove = 1,
+    TxVlanTagControlInsert = 2,
+    TxVlanTagControlReplace = 3,
+};
+
 struct TxDescriptorRead
 {
     // TDES0, TDES1
@@ -31,7 +39,7 @@ struct TxDescriptorRead
     // TDES2
 
     UINT16 Buf1Length : 14; // B1L
-    UINT16 VlanTagControl : 2; // VTIR
+    TxVlanTagControl VlanTagControl : 2; // VTIR
 
     UINT16 Buf2Length : 14; // B2L
     UINT16 TransmitTimestampEnable : 1; // TTSE
@@ -68,7 +76,7 @@ struct TxDescriptorReadTso
     // TDES2
 
     UINT16 Buf1Length : 14; // B1L (10-bit header length if FD = 1)
-    UINT16 VlanTagControl : 2; // VTIR
+    TxVlanTagControl VlanTagControl : 2; // VTIR
 
     UINT16 Buf2Length : 14; // B2L
     UINT16 TsoMemoryWriteDisable : 1; // TMWD
@@ -168,6 +176,7 @@ struct TxDescriptorContext
     UINT8 OneStepEnable : 1; // OSTC
     UINT8 Reserved28 : 2;
     UINT8 ContextType : 1; // CTXT = 1
+    UINT8 Own : 1; // OWN
 
 #if DBG
     UINT32 FragmentIndex;
@@ -185,11 +194,11 @@ struct RxDescriptorRead
 
     // RDES2
 
-    UINT32 Buf2Ap; // BUF2AP
+    UINT32 Buf2ApLow; // BUF2AP
 
     // RDES3
 
-    UINT16 Reserved0;
+    UINT16 Buf2ApHigh; // BUF2AP (40/48-bit addressing only)
     UINT8 Reserved16;
 
     UINT8 Buf1Valid : 1; // BUF1V
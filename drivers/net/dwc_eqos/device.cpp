@@ -11,6 +11,7 @@
 #include <dwc_eqos_perf.h>
 
 #include <acpiutil.hpp>
+#include <dwc_eqos_ptp.h>
 #include <bcrypt.h>
 
 /*
@@ -25,11 +26,51 @@ CreateTxQueue       DestroyCallback
 (DisarmWake)        (ArmWake)
 */
 
-static auto constexpr DefaultCsrRate = 125'000'000u;
+static auto constexpr DefaultCsrRate = 125'000'000u; // CSR clock, unless _DSD says otherwise.
+static auto constexpr DefaultPtpRefRate = 50'000'000u; // clk_ptp_ref_i, unless _DSD says otherwise.
+static auto constexpr NsPerSecond = 1'000'000'000u;
+static auto constexpr PtpTimestampQueueSize = 16u; // Per direction. The oldest is overwritten.
+static auto constexpr UnixEpochAsFileTime = 116'444'736'000'000'000u; // 1970-01-01 in 100ns units since 1601.
 static auto constexpr BusBytes = 8u;
-static auto constexpr QueuesSupported = 1u; // TODO: Support multiple queues?
+static auto constexpr ChannelsMax = 2u; // Size of the Dma_Ch and Mtl_Q register arrays.
+static auto constexpr TxQueuesSupported = 1u; // NetAdapterCx only asks for one Tx queue, so don't split the Tx FIFO.
+static auto constexpr MulticastHashListMax = 256u; // Multicast list limit when the hash filter is available.
+static auto constexpr VlanIdMax = 4094u;
+static auto constexpr EthernetHeaderSize = 14u;
+static auto constexpr JumboPacketMin = 1514u; // *JumboPacket "disabled": 1500-byte MTU.
+static auto constexpr JumboPacketMax = 9014u; // Mac_Configuration.JumboPacketEnable allows 9018 bytes including CRC.
+static auto constexpr DmaMaximumLength = 65536u;
+static_assert(JumboPacketMax <= DmaMaximumLength, "Tx frame must fit in one DMA transfer.");
+static_assert(TxTsoMaximumOffloadSize + 256u <= DmaMaximumLength, "Tx TSO packet must fit in one DMA transfer.");
+static auto constexpr TxCompletionTimeoutUs = 1000u; // Upper bound on Tx completion delay when IOC is batched.
+static auto constexpr PmtWakeFiltersMax = 4u; // Filters in MacRwkFilterBlock.
+static auto constexpr PmtWakeFilterBytes = 31u; // Bits in MacRwkFilterBlock.ByteMask.
+static auto constexpr PmtWakePatternSizeMax = 255u + PmtWakeFilterBytes; // MacRwkFilterBlock.Offset is 8 bits.
+static auto constexpr PhyAddressNone = 0xFFu;
+static auto constexpr PhyControl = 0u;          // Clause 22 BMCR.
+static auto constexpr PhyControlRestartAutoNeg = 0x0200u;
+static auto constexpr PhyControlAutoNegEnable = 0x1000u;
+static auto constexpr PhyId1 = 2u;              // Clause 22 PHYID1.
+static auto constexpr PhyMmdControl = 13u;      // Clause 22 MMD access control (clause 45 registers via clause 22).
+static auto constexpr PhyMmdData = 14u;         // Clause 22 MMD access address/data.
+static auto constexpr PhyMmdControlData = 0x4000u; // MMD access function: data, no post increment.
+static auto constexpr MmdPcs = 3u;
+static auto constexpr MmdPcsEeeCapability = 20u;
+static auto constexpr MmdAutoNeg = 7u;
+static auto constexpr MmdAutoNegEeeAdvertisement = 60u;
+static auto constexpr MmdAutoNegEeeLinkPartner = 61u;
+static auto constexpr EeeMode100BaseTx = 0x0002u; // EEE capability/advertisement bit.
+static auto constexpr EeeMode1000BaseT = 0x0004u; // EEE capability/advertisement bit.
+static auto constexpr LpiWakeTimerUs = 30u;     // Mac_Lpi_Timers_Control.WakeTimer: Tw_sys_tx for 100BASE-TX (1000BASE-T needs 16.5).
+static auto constexpr LpiLinkStatusTimerMs = 1000u; // Mac_Lpi_Timers_Control.LinkStatusTimer: link up before LPI (802.3az).
+static auto constexpr LpiEntryTimerMax = 0xFFFF8u; // Mac_Lpi_Entry_Timer bits 19:3.
+static auto constexpr TxThresholdMax = 512u; // MtlTxOperationMode_t.ThresholdControl = 7.
+static auto constexpr PauseFrameBytes = 84u;    // Pause frame with preamble and inter-packet gap.
+static auto constexpr PauseCableRoundTripNs = 1000u; // 100m of cable, both directions.
+static auto constexpr RxFlowControlUnit = 512u; // MtlRxOperationMode_t.FlowControlActivate/Deactivate: (value + 2) * 512 bytes.
+static auto constexpr RxFlowControlMax = (0x3Fu + 2u) * RxFlowControlUnit;
 static auto constexpr InterruptLinkStatus = 0x80000000u;
-static auto constexpr InterruptChannel0StatusMask = ~InterruptLinkStatus;
+static auto constexpr InterruptChannelStatusMask = ~InterruptLinkStatus;
 
 // D637828D-556C-4829-966A-237072F00FF1
 static GUID constexpr DsmGuid = { 0xD637828D, 0x556C, 0x4829, 0x96, 0x6A, 0x23, 0x70, 0x72, 0xF0, 0x0F, 0xF1 };
@@ -43,13 +84,53 @@ static WDFCOLLECTION g_devices = nullptr;   // Guarded by g_devicesLock.
 enum InterruptsWanted : UCHAR
 {
     InterruptsNone  = 0,
-    InterruptsState = 1 << 0, // mac.LinkStatus, ch0.AbnormalInterruptSummary, ch0.FatalBusError
-    InterruptsRx    = 1 << 1, // ch0.Rx
-    InterruptsTx    = 1 << 2, // ch0.Tx
+    InterruptsState = 1 << 0, // mac.LinkStatus (channel 0 only), ch.AbnormalInterruptSummary, ch.FatalBusError
+    InterruptsRx    = 1 << 1, // ch.Rx
+    InterruptsTx    = 1 << 2, // ch.Tx
     InterruptsAll   = static_cast<InterruptsWanted>(-1),
 };
 DEFINE_ENUM_FLAG_OPERATORS(InterruptsWanted);
 
+// State for one DMA channel. Channel N serves Rx queue N and Tx queue N.
+// Each channel has its own DPC so that channels can be serviced concurrently.
+struct ChannelContext
+{
+    // Const after initialization.
+
+    WDFDPC dpc;
+    WDFTIMER txCompletionTimer;
+
+    // Mutable.
+
+    ChannelStatus_t interruptStatus;    // Channel status (+ InterruptLinkStatus for channel 0). Interlocked update.
+    UINT64 isrTime;                     // KeQueryInterruptTimePrecise of the first ISR since the DPC ran, 0 = none. Interlocked update.
+    InterruptsWanted interruptsWanted;  // Guarded by interrupt lock.
+    NETPACKETQUEUE rxQueue;             // Guarded by queueLock.
+    NETPACKETQUEUE txQueue;             // Guarded by queueLock.
+
+    // Diagnostics/statistics.
+
+    UINT32 dpcRx; // Updated only in channel DPC.
+    UINT32 dpcTx; // Updated only in channel DPC.
+    UINT32 timerTx; // Updated only in Tx completion timer.
+    UINT32 dpcAbnormalStatus; // Updated only in channel DPC.
+    UINT32 dpcFatalBusError; // Updated only in channel DPC.
+    UINT32 rxOwnDescriptors; // Updated only during RxQueueAdvance.
+    UINT32 rxDoneFragments; // Updated only during RxQueueAdvance.
+    UINT32 txOwnDescriptors; // Updated only during TxQueueAdvance.
+    UINT32 txDoneFragments; // Updated only during TxQueueAdvance.
+    UINT32 txDonePackets; // Updated only during TxQueueAdvance.
+    UINT32 rxL3L4FilterMatches[L3L4FiltersMax]; // Updated only during RxQueueAdvance.
+
+    // Histograms (see PERF_HISTOGRAM_DATA).
+
+    UINT32 rxPacketsHistogram[PerfHistogramBuckets]; // Updated only during RxQueueAdvance.
+    UINT32 rxRingHistogram[PerfHistogramBuckets]; // Updated only during RxQueueAdvance.
+    UINT32 txPacketsHistogram[PerfHistogramBuckets]; // Updated only during TxQueueAdvance.
+    UINT32 txRingHistogram[PerfHistogramBuckets]; // Updated only during TxQueueAdvance.
+    UINT32 isrToDpcHistogram[PerfHistogramBuckets]; // Updated only in channel DPC.
+};
+
 struct DeviceContext
 {
     // Const after initialization.
@@ -57,9 +138,12 @@ struct DeviceContext
     MacRegisters* regs;
     NETADAPTER adapter;
     WDFSPINLOCK queueLock;
+    WDFSPINLOCK ptpLock;
     WDFWORKITEM updateLinkStateWorkItem;
+    WDFWORKITEM recoveryWorkItem;
     DEVICE_OBJECT* devicePdo;
     WDFINTERRUPT interrupt;
+    WDFINTERRUPT pmtInterrupt; // nullptr if there is no PMT interrupt resource.
     WDFDMAENABLER dma;
     UINT32 perfCounterDeviceId; // = (regs physical address) >> 4
     MacHwFeature0_t feature0;
@@ -68,41 +152,132 @@ struct DeviceContext
     MacHwFeature3_t feature3;
     UINT8 permanentMacAddress[ETHERNET_LENGTH_OF_ADDRESS];
     UINT8 currentMacAddress[ETHERNET_LENGTH_OF_ADDRESS];
+    UINT8 rxQueueCount; // Number of Rx queues (and DMA channels) offered to NetAdapterCx, 1..ChannelsMax.
+    UINT8 phyAddress;   // MDIO address of the PHY, PhyAddressNone if not probed (config.eee is false).
     DeviceConfig config;
 
     // Mutable.
 
-    ChannelStatus_t interruptStatus;    // Channel0 + InterruptLinkStatus. Interlocked update.
     char updateLinkStateBusy;           // 0 = idle, 1 = busy. Interlocked update.
-
-    InterruptsWanted interruptsWanted;  // Guarded by interrupt lock.
-    NETPACKETQUEUE rxQueue;             // Guarded by queueLock.
-    NETPACKETQUEUE txQueue;             // Guarded by queueLock.
+    char recoveryRequested;             // 0 = running, 1 = fatal error, restart requested. Interlocked update.
+    UINT64 recoveryStartTime;           // KeQueryInterruptTime of the fatal error, 0 = none. Persisted across the restart.
+    bool ptpRunning;                    // Guarded by ptpLock. Set in D0 if config.ptpTimestamp.
+    UINT32 ptpAddendBase;               // Guarded by ptpLock. Mac_Timestamp_Addend for 0 ppb.
+    struct
+    {
+        UINT64 timeNs;                  // 0 = empty or already retrieved.
+        PtpMessageId id;
+    } ptpTimestamps[2][PtpTimestampQueueSize]; // Guarded by ptpLock. [transmit][i], see DeviceSetPacketTimestamp.
+    UINT8 ptpTimestampNext[2];          // Guarded by ptpLock. Next ptpTimestamps slot to write.
+    UINT8 rxQueuesStarted;              // Bit N = Rx queue N is started. See DeviceSetRxQueueStarted.
+    ChannelContext channels[ChannelsMax];
 
     // Diagnostics/statistics.
 
     UINT32 isrHandled; // Updated only in ISR.
     UINT32 isrIgnored; // Updated only in ISR.
-    UINT32 dpcLinkState; // Updated only in DPC.
-    UINT32 dpcRx; // Updated only in DPC.
-    UINT32 dpcTx; // Updated only in DPC.
-    UINT32 dpcAbnormalStatus; // Updated only in DPC.
-    UINT32 dpcFatalBusError; // Updated only in DPC.
-    UINT32 rxOwnDescriptors; // Updated only during RxQueueAdvance.
-    UINT32 rxDoneFragments; // Updated only during RxQueueAdvance.
-    UINT32 txOwnDescriptors; // Updated only during TxQueueAdvance.
-    UINT32 txDoneFragments; // Updated only during TxQueueAdvance.
+    UINT32 dpcLinkState; // Updated only in channel 0 DPC.
+    UINT32 pmtWakes; // Updated only in PMT ISR.
+    UINT32 recoveries; // Completed fatal error recoveries. Updated only in D0Entry. Persisted.
+    UINT32 recoveryMilliseconds; // Duration of the most recent recovery. Updated only in D0Entry. Persisted.
 };
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DeviceContext, DeviceGetContext)
 
+// Context for the per-channel DPC and timer.
+struct ChannelDpcContext
+{
+    UINT8 channel;
+};
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(ChannelDpcContext, ChannelDpcGetContext)
+
 struct AdapterContext
 {
     WDFDEVICE device;
 };
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(AdapterContext, AdapterGetContext)
 
+// Returns the PERF_HISTOGRAM_DATA log2 bucket for a value: 0, 1, 2-3, 4-7, ..., 64+.
+static unsigned
+HistogramLog2Bucket(UINT64 value)
+{
+    // Any IRQL
+    unsigned long index;
+    return _BitScanReverse64(&index, value)
+        ? min(index + 1u, PerfHistogramBuckets - 1u)
+        : 0u;
+}
+
+// Returns the PERF_HISTOGRAM_DATA ring bucket (eighths of the ring) for a descriptor count.
+static unsigned
+HistogramRingBucket(UINT32 descUsed, UINT32 descCount)
+{
+    // Any IRQL
+    return min(descUsed * PerfHistogramBuckets / descCount, PerfHistogramBuckets - 1u);
+}
+
+// Returns the number of bits in the multicast hash table (0, 64, 128, or 256).
+static unsigned
+MulticastHashBits(_In_ DeviceContext const* context)
+{
+    // Any IRQL
+    return context->feature1.HashTableSize == HashTableSize_0
+        ? 0u
+        : 32u << context->feature1.HashTableSize;
+}
+
+// Returns the MAC_VLAN_Hash_Table bit for a 12-bit VLAN ID: the top 4 bits of the
+// bit-reversed CRC-32 of the VLAN ID (12 bits, LSB first).
+static unsigned
+VlanHashIndex(UINT16 vlanId)
+{
+    // Any IRQL
+    UINT32 crc = 0xFFFFFFFF;
+    for (unsigned bit = 0; bit != 12; bit += 1)
+    {
+        auto const temp = (crc ^ (vlanId >> bit)) & 1;
+        crc = (crc >> 1) ^ (0xEDB88320 & (0u - temp));
+    }
+    crc = ~crc;
+
+    UINT32 reversed = 0;
+    for (unsigned bit = 0; bit != 32; bit += 1)
+    {
+        reversed = (reversed << 1) | ((crc >> bit) & 1);
+    }
+
+    return reversed >> 28;
+}
+
+// Returns the hash table bit for an address: the top log2(hashBits) bits of the
+// bit-reversed Ethernet CRC-32 of the address.
+static unsigned
+MulticastHashIndex(_In_reads_(6) UINT8 const* addr, unsigned hashBits)
+{
+    // Any IRQL
+    UINT32 crc = 0xFFFFFFFF;
+    for (unsigned i = 0; i != ETHERNET_LENGTH_OF_ADDRESS; i += 1)
+    {
+        crc ^= addr[i];
+        for (unsigned bit = 0; bit != 8; bit += 1)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+        }
+    }
+    crc = ~crc;
+
+    UINT32 reversed = 0;
+    for (unsigned bit = 0; bit != 32; bit += 1)
+    {
+        reversed = (reversed << 1) | ((crc >> bit) & 1);
+    }
+
+    ULONG log2Bits;
+    _BitScanReverse(&log2Bits, hashBits);
+    return reversed >> (32 - log2Bits);
+}
+
 static void
-SetOneMacAddress(_Inout_ MacRegisters* regs, unsigned index, _In_reads_(6) UINT8 const* addr, bool enable)
+SetOneMacAddress(_Inout_ MacRegisters* regs, unsigned index, _In_reads_(6) UINT8 const* addr, bool enable, UINT8 dmaChannel)
 {
     // PASSIVE_LEVEL, nonpaged (resume path)
     MacAddressRegisters addrRegs = {};
@@ -112,6 +287,7 @@ SetOneMacAddress(_Inout_ MacRegisters* regs, unsigned index, _In_reads_(6) UINT8
     addrRegs.Low.Addr3 = addr[3];
     addrRegs.High.Addr4 = addr[4];
     addrRegs.High.Addr5 = addr[5];
+    addrRegs.High.DmaChannelSelect = dmaChannel;
     addrRegs.High.AddressEnable = enable;
 
     Write32(&regs->Mac_Address[index].High, addrRegs.High);
@@ -141,7 +317,7 @@ DeviceReset(_Inout_ MacRegisters* regs, _In_reads_(6) UINT8 const* mac0)
         auto const dmaMode = Read32(&regs->Dma_Mode);
         if (0 == (dmaMode & 1))
         {
-            SetOneMacAddress(regs, 0, mac0, true);
+            SetOneMacAddress(regs, 0, mac0, true, 0);
             TraceEntryExit(DeviceReset, LEVEL_INFO,
                 TraceLoggingUInt32(retry));
             return STATUS_SUCCESS;
@@ -152,6 +328,330 @@ DeviceReset(_Inout_ MacRegisters* regs, _In_reads_(6) UINT8 const* mac0)
     return STATUS_TIMEOUT;
 }
 
+// Returns Mac_Mdio_Address.CsrClockRange for the given CSR clock rate, i.e. the
+// smallest divider that keeps MDC at or below 2.5 MHz.
+static UINT8
+MdioClockRange(UINT32 csrRate)
+{
+    // Any IRQL
+    return csrRate < 35'000'000u ? 2u   // CSR clock / 16
+        : csrRate < 60'000'000u ? 3u    // CSR clock / 26
+        : csrRate < 100'000'000u ? 0u   // CSR clock / 42
+        : csrRate < 150'000'000u ? 1u   // CSR clock / 62
+        : csrRate < 250'000'000u ? 4u   // CSR clock / 102
+        : csrRate < 300'000'000u ? 5u   // CSR clock / 124
+        : csrRate < 500'000'000u ? 6u   // CSR clock / 204
+        : 7u;                           // CSR clock / 324
+}
+
+// Waits for the MDIO transaction started by MdioRead or MdioWrite to complete.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+MdioWait(_In_ MacRegisters* regs)
+{
+    // DISPATCH_LEVEL
+    for (unsigned retry = 0; retry != 100; retry += 1)
+    {
+        if (!Read32(&regs->Mac_Mdio_Address).Busy)
+        {
+            return STATUS_SUCCESS;
+        }
+
+        KeStallExecutionProcessor(10);
+    }
+
+    TraceWrite("MdioWait-timeout", LEVEL_WARNING);
+    return STATUS_IO_TIMEOUT;
+}
+
+// Reads a clause 22 PHY register.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+MdioRead(
+    _In_ DeviceContext const* context,
+    UINT8 phyAddress,
+    UINT8 reg,
+    _Out_ UINT16* value)
+{
+    // DISPATCH_LEVEL
+    auto const regs = context->regs;
+    MacMdioAddress_t mdioAddress = {};
+    mdioAddress.Busy = true;
+    mdioAddress.Operation = MdioOperation_Read;
+    mdioAddress.CsrClockRange = MdioClockRange(context->config.csrRate);
+    mdioAddress.RegisterAddress = reg;
+    mdioAddress.PhysicalLayerAddress = phyAddress;
+    Write32(&regs->Mac_Mdio_Address, mdioAddress);
+
+    auto const status = MdioWait(regs);
+    *value = NT_SUCCESS(status) ? static_cast<UINT16>(Read32(&regs->Mac_Mdio_Data)) : 0xFFFFu;
+    return status;
+}
+
+// Writes a clause 22 PHY register.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+MdioWrite(
+    _In_ DeviceContext const* context,
+    UINT8 phyAddress,
+    UINT8 reg,
+    UINT16 value)
+{
+    // DISPATCH_LEVEL
+    auto const regs = context->regs;
+    Write32(&regs->Mac_Mdio_Data, value);
+
+    MacMdioAddress_t mdioAddress = {};
+    mdioAddress.Busy = true;
+    mdioAddress.Operation = MdioOperation_Write;
+    mdioAddress.CsrClockRange = MdioClockRange(context->config.csrRate);
+    mdioAddress.RegisterAddress = reg;
+    mdioAddress.PhysicalLayerAddress = phyAddress;
+    Write32(&regs->Mac_Mdio_Address, mdioAddress);
+
+    return MdioWait(regs);
+}
+
+// Reads a clause 45 MMD register through the clause 22 MMD access registers.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PhyMmdRead(
+    _In_ DeviceContext const* context,
+    UINT8 phyAddress,
+    UINT16 mmd,
+    UINT16 reg,
+    _Out_ UINT16* value)
+{
+    // DISPATCH_LEVEL
+    NTSTATUS status;
+    if (!NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdControl, mmd)) ||
+        !NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdData, reg)) ||
+        !NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdControl, static_cast<UINT16>(PhyMmdControlData | mmd))))
+    {
+        *value = 0xFFFFu;
+        return status;
+    }
+
+    return MdioRead(context, phyAddress, PhyMmdData, value);
+}
+
+// Writes a clause 45 MMD register through the clause 22 MMD access registers.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PhyMmdWrite(
+    _In_ DeviceContext const* context,
+    UINT8 phyAddress,
+    UINT16 mmd,
+    UINT16 reg,
+    UINT16 value)
+{
+    // DISPATCH_LEVEL
+    NTSTATUS status;
+    if (!NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdControl, mmd)) ||
+        !NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdData, reg)) ||
+        !NT_SUCCESS(status = MdioWrite(context, phyAddress, PhyMmdControl, static_cast<UINT16>(PhyMmdControlData | mmd))))
+    {
+        return status;
+    }
+
+    return MdioWrite(context, phyAddress, PhyMmdData, value);
+}
+
+// Returns the lowest MDIO address with a PHY, or PhyAddressNone.
+_IRQL_requires_(PASSIVE_LEVEL)
+__declspec(code_seg("PAGE"))
+static UINT8
+DevicePhyFind(_In_ DeviceContext const* context)
+{
+    // PASSIVE_LEVEL
+    PAGED_CODE();
+
+    for (unsigned i = 0; i != 32; i += 1)
+    {
+        auto const phyAddress = static_cast<UINT8>(i);
+        UINT16 id1;
+        if (NT_SUCCESS(MdioRead(context, phyAddress, PhyId1, &id1)) &&
+            id1 != 0 && id1 != 0xFFFF)
+        {
+            TraceEntryExit(DevicePhyFind, LEVEL_INFO,
+                TraceLoggingUInt8(phyAddress),
+                TraceLoggingHexInt16(id1));
+            return phyAddress;
+        }
+    }
+
+    TraceEntryExit(DevicePhyFind, LEVEL_WARNING);
+    return PhyAddressNone;
+}
+
+// Makes the PHY advertise EEE for each speed that it supports. Restarts
+// auto-negotiation if the advertisement changed. Called by DeviceD0Entry if config.eee.
+_IRQL_requires_(PASSIVE_LEVEL)
+static void
+DeviceEeeAdvertise(_In_ DeviceContext const* context)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const regs = context->regs;
+    auto const phyAddress = context->phyAddress;
+    UINT16 capability = 0, oldAdvertisement = 0, newAdvertisement = 0, control = 0;
+
+    if (NT_SUCCESS(PhyMmdRead(context, phyAddress, MmdPcs, MmdPcsEeeCapability, &capability)) &&
+        NT_SUCCESS(PhyMmdRead(context, phyAddress, MmdAutoNeg, MmdAutoNegEeeAdvertisement, &oldAdvertisement)))
+    {
+        auto const modes = EeeMode100BaseTx | EeeMode1000BaseT;
+        newAdvertisement = static_cast<UINT16>((oldAdvertisement & ~modes) | (capability & modes));
+        if (newAdvertisement != oldAdvertisement &&
+            NT_SUCCESS(PhyMmdWrite(context, phyAddress, MmdAutoNeg, MmdAutoNegEeeAdvertisement, newAdvertisement)) &&
+            NT_SUCCESS(MdioRead(context, phyAddress, PhyControl, &control)) &&
+            (control & PhyControlAutoNegEnable))
+        {
+            (void)MdioWrite(context, phyAddress, PhyControl, static_cast<UINT16>(control | PhyControlRestartAutoNeg));
+        }
+    }
+
+    // Timers are used when UpdateLinkState enables LPI.
+    MacLpiTimersControl_t lpiTimers = {};
+    lpiTimers.WakeTimer = LpiWakeTimerUs;
+    lpiTimers.LinkStatusTimer = LpiLinkStatusTimerMs;
+    Write32(&regs->Mac_Lpi_Timers_Control, lpiTimers);
+    Write32(&regs->Mac_Lpi_Entry_Timer, context->config.lpiEntryTimer);
+
+    TraceEntryExit(DeviceEeeAdvertise, LEVEL_INFO,
+        TraceLoggingHexInt16(capability),
+        TraceLoggingHexInt16(oldAdvertisement),
+        TraceLoggingHexInt16(newAdvertisement),
+        TraceLoggingHexInt16(control));
+}
+
+// Enables LPI if the link is full duplex at a speed where both link partners
+// advertise EEE, otherwise disables it. Called by UpdateLinkState if config.eee.
+_IRQL_requires_(PASSIVE_LEVEL)
+static void
+DeviceEeeUpdate(
+    _In_ DeviceContext const* context,
+    MacPhyIfControlStatus_t controlStatus)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const regs = context->regs;
+    UINT16 const mode = static_cast<UINT16>(
+        !controlStatus.LinkUp || !controlStatus.FullDuplex ? 0u
+        : controlStatus.Speed == PhyIfSpeed_125M ? EeeMode1000BaseT
+        : controlStatus.Speed == PhyIfSpeed_25M ? EeeMode100BaseTx
+        : 0u);
+    UINT16 advertisement = 0, linkPartner = 0;
+
+    if (mode != 0)
+    {
+        (void)PhyMmdRead(context, context->phyAddress, MmdAutoNeg, MmdAutoNegEeeAdvertisement, &advertisement);
+        (void)PhyMmdRead(context, context->phyAddress, MmdAutoNeg, MmdAutoNegEeeLinkPartner, &linkPartner);
+    }
+
+    // The Tx path enters LPI after lpiEntryTimer of idle and leaves it automatically
+    // when a packet is queued.
+    MacLpiControlStatus_t lpiControl = {};
+    lpiControl.PhyLinkStatus = controlStatus.LinkUp;
+    if ((advertisement & linkPartner & mode) != 0)
+    {
+        lpiControl.LpiEnable = true;
+        lpiControl.LpTxAutomate = true;
+        lpiControl.LpiTimerEnable = true;
+    }
+
+    Write32(&regs->Mac_Lpi_Control_Status, lpiControl);
+
+    TraceEntryExit(DeviceEeeUpdate, LEVEL_INFO,
+        TraceLoggingHexInt16(mode),
+        TraceLoggingHexInt16(advertisement),
+        TraceLoggingHexInt16(linkPartner),
+        TraceLoggingBoolean(lpiControl.LpiEnable, "lpiEnable"));
+}
+
+// Returns the Rx FIFO bytes assigned to each Rx queue. The FIFO is split evenly.
+static UINT32
+RxQueueFifoSize(_In_ DeviceContext const* context)
+{
+    // Any IRQL
+    UINT32 const rxFifoSize =
+        context->feature1.RxFifoSize > 23 ? 0x80000000 // Probably can't happen.
+        : 128u << context->feature1.RxFifoSize; // RK3588 has 32KB.
+    return rxFifoSize / context->rxQueueCount > 0x100000 ? 0x100000 // QueueSize field can express up to 1MB (assuming that the 5 Reserved bits are actually QueueSize).
+        : rxFifoSize / context->rxQueueCount;
+}
+
+// Computes the Rx queue flow control thresholds (free bytes) for the link speed.
+// A pause frame is sent when free space drops to activate, so activate must hold
+// everything that arrives before the link partner stops: the frame being received,
+// our own Tx frame that delays the pause frame, the pause frame, the partner's
+// response time (802.3 Annex 31B) and the cable round trip. A zero-quanta pause
+// frame is sent when free space rises to deactivate.
+static void
+RxFlowControlThresholds(
+    _In_ DeviceContext const* context,
+    UINT32 rxQueueSize,
+    UINT32 speed,
+    _Out_ UINT32* activate,
+    _Out_ UINT32* deactivate)
+{
+    // Any IRQL
+    UINT32 const frameBytes = context->config.jumboPacket + 8u; // + VLAN tag and CRC.
+    UINT32 const responseBytes = speed >= 1'000'000'000u ? 128u : 64u; // 2 or 1 pause quanta.
+    UINT32 const cableBytes = static_cast<UINT32>(UINT64(speed) * PauseCableRoundTripNs / NsPerSecond / 8u);
+    UINT32 const headroom = 2u * frameBytes + PauseFrameBytes + responseBytes + cableBytes;
+    UINT32 const frameUnits = (frameBytes + RxFlowControlUnit - 1) & ~(RxFlowControlUnit - 1);
+
+    // Keep at least half of the queue for buffering, even if that leaves less headroom.
+    UINT32 const activateMax = min(rxQueueSize / 2u, RxFlowControlMax);
+    *activate = max(2u * RxFlowControlUnit, min((headroom + RxFlowControlUnit - 1) & ~(RxFlowControlUnit - 1), activateMax));
+    *deactivate = min(*activate + max(frameUnits, *activate / 2u), min(rxQueueSize - RxFlowControlUnit, RxFlowControlMax));
+}
+
+// Updates the Rx queues' flow control thresholds for a new link speed.
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static void
+DeviceRxFlowControlTune(
+    _In_ DeviceContext const* context,
+    UINT32 speed)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const rxQueueSize = RxQueueFifoSize(context);
+    if (speed == 0 ||
+        !(context->config.flowControl & FlowControlTxPause) ||
+        rxQueueSize < 2048)
+    {
+        return;
+    }
+
+    UINT32 activate, deactivate;
+    RxFlowControlThresholds(context, rxQueueSize, speed, &activate, &deactivate);
+    for (unsigned queue = 0; queue != context->rxQueueCount; queue += 1)
+    {
+        auto rxOperationMode = Read32(&context->regs->Mtl_Q[queue].Rx_Operation_Mode);
+        rxOperationMode.FlowControlActivate = activate / RxFlowControlUnit - 2u;
+        rxOperationMode.FlowControlDeactivate = deactivate / RxFlowControlUnit - 2u;
+        Write32(&context->regs->Mtl_Q[queue].Rx_Operation_Mode, rxOperationMode);
+    }
+
+    TraceEntryExit(DeviceRxFlowControlTune, LEVEL_INFO,
+        TraceLoggingUInt32(speed),
+        TraceLoggingHexInt32(activate),
+        TraceLoggingHexInt32(deactivate));
+}
+
+// Returns MtlTxOperationMode_t.ThresholdControl for DeviceConfig::txThreshold.
+static UINT32
+TxThresholdControl(UINT16 txThreshold)
+{
+    // Any IRQL
+    return txThreshold <= 32 ? 0u
+        : txThreshold <= 64 ? 1u
+        : txThreshold <= 96 ? 2u
+        : txThreshold <= 128 ? 3u
+        : txThreshold <= 192 ? 4u
+        : txThreshold <= 256 ? 5u
+        : txThreshold <= 384 ? 6u
+        : 7u; // 512
+}
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 static void
 UpdateLinkState(_In_ DeviceContext const* context)
@@ -213,13 +713,24 @@ UpdateLinkState(_In_ DeviceContext const* context)
         Write32(&context->regs->Mac_Configuration, newConfig);
     }
 
+    if (context->config.eee)
+    {
+        DeviceEeeUpdate(context, controlStatus);
+    }
+
+    DeviceRxFlowControlTune(context, controlStatus.LinkUp ? speed : 0u);
+
+    auto const flowControl = context->config.flowControl;
     NET_ADAPTER_LINK_STATE linkState;
     NET_ADAPTER_LINK_STATE_INIT(
         &linkState,
         speed,
         controlStatus.LinkUp ? MediaConnectStateConnected : MediaConnectStateDisconnected,
         controlStatus.FullDuplex ? MediaDuplexStateFull : MediaDuplexStateHalf,
-        NetAdapterPauseFunctionTypeUnsupported, // TODO: Pause functions?
+        flowControl == (FlowControlTxPause | FlowControlRxPause) ? NetAdapterPauseFunctionTypeSendAndReceive
+        : flowControl == FlowControlTxPause ? NetAdapterPauseFunctionTypeSendOnly
+        : flowControl == FlowControlRxPause ? NetAdapterPauseFunctionTypeReceiveOnly
+        : NetAdapterPauseFunctionTypeUnsupported,
         NetAdapterAutoNegotiationFlagXmitLinkSpeedAutoNegotiated |
         NetAdapterAutoNegotiationFlagRcvLinkSpeedautoNegotiated |
         NetAdapterAutoNegotiationFlagDuplexAutoNegotiated);
@@ -257,34 +768,41 @@ MakeChannelInterruptEnable(InterruptsWanted wanted)
     return interruptEnable;
 }
 
+// MAC interrupts (link state) are controlled along with channel 0.
 _IRQL_requires_max_(HIGH_LEVEL)
 static void
-DeviceInterruptSet_Locked(_Inout_ MacRegisters* regs, InterruptsWanted wanted)
+DeviceInterruptSet_Locked(_Inout_ MacRegisters* regs, unsigned channel, InterruptsWanted wanted)
 {
     // HIGH_LEVEL
-    Write32(&regs->Mac_Interrupt_Enable, MakeMacInterruptEnable(wanted));
-    Write32(&regs->Dma_Ch[0].Interrupt_Enable, MakeChannelInterruptEnable(wanted));
+    NT_ASSERT(channel < ChannelsMax);
+    if (channel == 0)
+    {
+        Write32(&regs->Mac_Interrupt_Enable, MakeMacInterruptEnable(wanted));
+    }
+    Write32(&regs->Dma_Ch[channel].Interrupt_Enable, MakeChannelInterruptEnable(wanted));
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 static void
-DeviceInterruptEnable(_Inout_ DeviceContext* context, InterruptsWanted bitsToEnable)
+DeviceInterruptEnable(_Inout_ DeviceContext* context, unsigned channel, InterruptsWanted bitsToEnable)
 {
     // DISPATCH_LEVEL
+    auto const channelContext = &context->channels[channel];
 
     WdfInterruptAcquireLock(context->interrupt); // DISPATCH_LEVEL --> HIGH_LEVEL
-    auto const oldWanted = context->interruptsWanted;
+    auto const oldWanted = channelContext->interruptsWanted;
     auto const newWanted = static_cast<InterruptsWanted>(oldWanted | bitsToEnable);
     if (oldWanted != newWanted)
     {
-        context->interruptsWanted = newWanted;
-        DeviceInterruptSet_Locked(context->regs, newWanted);
+        channelContext->interruptsWanted = newWanted;
+        DeviceInterruptSet_Locked(context->regs, channel, newWanted);
     }
     WdfInterruptReleaseLock(context->interrupt); // HIGH_LEVEL --> DISPATCH_LEVEL
 
     if (oldWanted != newWanted)
     {
         TraceEntryExit(DeviceInterruptEnable, LEVEL_VERBOSE,
+            TraceLoggingUInt32(channel),
             TraceLoggingHexInt32(oldWanted, "old"),
             TraceLoggingHexInt32(newWanted, "new"));
     }
@@ -292,23 +810,25 @@ DeviceInterruptEnable(_Inout_ DeviceContext* context, InterruptsWanted bitsToEna
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 static void
-DeviceInterruptDisable(_Inout_ DeviceContext* context, InterruptsWanted bitsToDisable)
+DeviceInterruptDisable(_Inout_ DeviceContext* context, unsigned channel, InterruptsWanted bitsToDisable)
 {
     // DISPATCH_LEVEL
+    auto const channelContext = &context->channels[channel];
 
     WdfInterruptAcquireLock(context->interrupt); // DISPATCH_LEVEL --> HIGH_LEVEL
-    auto const oldWanted = context->interruptsWanted;
+    auto const oldWanted = channelContext->interruptsWanted;
     auto const newWanted = static_cast<InterruptsWanted>(oldWanted & ~bitsToDisable);
     if (oldWanted != newWanted)
     {
-        context->interruptsWanted = newWanted;
-        DeviceInterruptSet_Locked(context->regs, newWanted);
+        channelContext->interruptsWanted = newWanted;
+        DeviceInterruptSet_Locked(context->regs, channel, newWanted);
     }
     WdfInterruptReleaseLock(context->interrupt); // HIGH_LEVEL --> DISPATCH_LEVEL
 
     if (oldWanted != newWanted)
     {
         TraceWrite("DeviceInterruptDisable", LEVEL_VERBOSE,
+            TraceLoggingUInt32(channel),
             TraceLoggingHexInt32(oldWanted, "old"),
             TraceLoggingHexInt32(newWanted, "new"));
     }
@@ -324,40 +844,63 @@ DeviceInterruptIsr(
     UNREFERENCED_PARAMETER(messageId);
     auto const context = DeviceGetContext(WdfInterruptGetDevice(interrupt));
     auto const regs = context->regs;
-
-    ChannelStatus_t newInterruptStatus = {};
+    bool handled = false;
 
     auto const mac = Read32(&regs->Mac_Interrupt_Status);
     if (mac.LinkStatus)
     {
-        newInterruptStatus.Value32 |= InterruptLinkStatus;
         (void)Read32(&regs->Mac_PhyIf_Control_Status); // Clears interrupt status.
     }
 
-    auto const channel0 = Read32(&regs->Dma_Ch[0].Status);
-    newInterruptStatus.Value32 |= channel0.Value32 & InterruptChannel0StatusMask;
-
-    if (newInterruptStatus.Value32 != 0)
+    auto const dma = Read32(&regs->Dma_Interrupt_Status);
+    for (unsigned channel = 0; channel != context->rxQueueCount; channel += 1)
     {
-        Write32(&regs->Dma_Ch[0].Status, channel0); // Clears Dma_Ch0.Status.
-
-        // Disable interrupts until DPC runs.
-        DeviceInterruptSet_Locked(regs, InterruptsNone); // Interrupt lock is already held.
+        auto const channelContext = &context->channels[channel];
+        ChannelStatus_t newInterruptStatus = {};
 
-        if (newInterruptStatus.Rx)
+        if (channel == 0 && mac.LinkStatus)
         {
-            context->interruptsWanted &= ~InterruptsRx;
+            newInterruptStatus.Value32 |= InterruptLinkStatus;
         }
 
-        if (newInterruptStatus.Tx)
+        ChannelStatus_t channelStatus = {};
+        if (dma.Value32 & (1u << channel))
         {
-            context->interruptsWanted &= ~InterruptsTx;
+            channelStatus = Read32(&regs->Dma_Ch[channel].Status);
+            newInterruptStatus.Value32 |= channelStatus.Value32 & InterruptChannelStatusMask;
         }
 
-        static_assert(sizeof(long) == sizeof(context->interruptStatus));
-        InterlockedOrNoFence(reinterpret_cast<long*>(&context->interruptStatus), newInterruptStatus.Value32);
-        WdfInterruptQueueDpcForIsr(interrupt);
+        if (newInterruptStatus.Value32 != 0)
+        {
+            Write32(&regs->Dma_Ch[channel].Status, channelStatus); // Clears Dma_Ch.Status.
+
+            // Disable this channel's interrupts until its DPC runs.
+            DeviceInterruptSet_Locked(regs, channel, InterruptsNone); // Interrupt lock is already held.
+
+            if (newInterruptStatus.Rx)
+            {
+                channelContext->interruptsWanted &= ~InterruptsRx;
+            }
+
+            if (newInterruptStatus.Tx)
+            {
+                channelContext->interruptsWanted &= ~InterruptsTx;
+            }
+
+            static_assert(sizeof(long) == sizeof(channelContext->interruptStatus));
+            InterlockedOrNoFence(reinterpret_cast<long*>(&channelContext->interruptStatus), newInterruptStatus.Value32);
+            ULONG64 qpc;
+            InterlockedCompareExchangeNoFence64(
+                reinterpret_cast<LONG64*>(&channelContext->isrTime),
+                KeQueryInterruptTimePrecise(&qpc),
+                0);
+            WdfDpcEnqueue(channelContext->dpc);
+            handled = true;
+        }
+    }
 
+    if (handled)
+    {
         context->isrHandled += 1;
         return true;
     }
@@ -366,22 +909,31 @@ DeviceInterruptIsr(
     return false;
 }
 
-static EVT_WDF_INTERRUPT_DPC DeviceInterruptDpc;
+static EVT_WDF_DPC DeviceChannelDpc;
 static void
-DeviceInterruptDpc(
-    _In_ WDFINTERRUPT interrupt,
-    _In_ WDFOBJECT associatedObject)
+DeviceChannelDpc(_In_ WDFDPC dpc)
 {
     // DISPATCH_LEVEL
-    UNREFERENCED_PARAMETER(interrupt);
-    auto const context = DeviceGetContext(associatedObject);
-    NT_ASSERT(context->interrupt == interrupt);
+    auto const context = DeviceGetContext(WdfDpcGetParentObject(dpc));
+    unsigned const channel = ChannelDpcGetContext(dpc)->channel;
+    auto const channelContext = &context->channels[channel];
+    NT_ASSERT(channelContext->dpc == dpc);
+
+    // Zero if the DPC was queued by the Tx completion timer instead of the ISR.
+    auto const isrTime = static_cast<UINT64>(
+        InterlockedExchangeNoFence64(reinterpret_cast<LONG64*>(&channelContext->isrTime), 0));
+    if (isrTime != 0)
+    {
+        ULONG64 qpc;
+        auto const delay = KeQueryInterruptTimePrecise(&qpc) - isrTime; // 100ns units
+        channelContext->isrToDpcHistogram[HistogramLog2Bucket(delay / 10u)] += 1;
+    }
 
     for (;;)
     {
-        static_assert(sizeof(long) == sizeof(context->interruptStatus));
+        static_assert(sizeof(long) == sizeof(channelContext->interruptStatus));
         auto const newInterruptStatus =
-            ChannelStatus_t(InterlockedExchangeNoFence(reinterpret_cast<long*>(&context->interruptStatus), 0));
+            ChannelStatus_t(InterlockedExchangeNoFence(reinterpret_cast<long*>(&channelContext->interruptStatus), 0));
         if (newInterruptStatus.Value32 == 0)
         {
             break;
@@ -389,6 +941,7 @@ DeviceInterruptDpc(
 
         if (newInterruptStatus.Value32 & InterruptLinkStatus)
         {
+            NT_ASSERT(channel == 0);
             context->dpcLinkState += 1;
             Read32(&context->regs->Mac_PhyIf_Control_Status); // Clears LinkStatus interrupt.
             WdfWorkItemEnqueue(context->updateLinkStateWorkItem);
@@ -398,20 +951,20 @@ DeviceInterruptDpc(
         {
             WdfSpinLockAcquire(context->queueLock);
 
-            auto const rxQueue = context->rxQueue;
+            auto const rxQueue = channelContext->rxQueue;
             if (rxQueue && newInterruptStatus.Rx)
             {
-                context->dpcRx += 1;
+                channelContext->dpcRx += 1;
                 NetRxQueueNotifyMoreReceivedPacketsAvailable(rxQueue);
-                context->rxQueue = nullptr;
+                channelContext->rxQueue = nullptr;
             }
 
-            auto const txQueue = context->txQueue;
+            auto const txQueue = channelContext->txQueue;
             if (txQueue && newInterruptStatus.Tx)
             {
-                context->dpcTx += 1;
+                channelContext->dpcTx += 1;
                 NetTxQueueNotifyMoreCompletedPacketsAvailable(txQueue);
-                context->txQueue = nullptr;
+                channelContext->txQueue = nullptr;
             }
 
             WdfSpinLockRelease(context->queueLock);
@@ -419,28 +972,57 @@ DeviceInterruptDpc(
 
         if (newInterruptStatus.AbnormalInterruptSummary || newInterruptStatus.FatalBusError)
         {
-            // TODO - error recovery?
-            context->dpcAbnormalStatus += newInterruptStatus.AbnormalInterruptSummary;
-            context->dpcFatalBusError += newInterruptStatus.FatalBusError;
-            TraceWrite("DeviceInterruptDpc-ERROR", LEVEL_ERROR,
+            channelContext->dpcAbnormalStatus += newInterruptStatus.AbnormalInterruptSummary;
+            channelContext->dpcFatalBusError += newInterruptStatus.FatalBusError;
+            TraceWrite("DeviceChannelDpc-ERROR", LEVEL_ERROR,
+                TraceLoggingUInt32(channel),
                 TraceLoggingHexInt32(newInterruptStatus.Value32, "status"));
+
+            // Fatal bus error stops the channel's DMA engine. Abnormal status alone
+            // (e.g. Rx buffer unavailable) is recoverable without intervention.
+            if (newInterruptStatus.FatalBusError &&
+                0 == InterlockedExchangeNoFence8(&context->recoveryRequested, 1))
+            {
+                context->recoveryStartTime = KeQueryInterruptTime();
+                WdfWorkItemEnqueue(context->recoveryWorkItem);
+            }
         }
         else
         {
-            TraceWrite("DeviceInterruptDpc", LEVEL_VERBOSE,
+            TraceWrite("DeviceChannelDpc", LEVEL_VERBOSE,
+                TraceLoggingUInt32(channel),
                 TraceLoggingHexInt32(newInterruptStatus.Value32, "status"));
         }
 
-        // Enable interrupts if disabled by ISR.
+        // Enable interrupts if disabled by ISR (unless the device is about to be restarted).
         WdfInterruptAcquireLock(context->interrupt); // DISPATCH_LEVEL --> HIGH_LEVEL
-        if (context->interruptsWanted != InterruptsNone)
+        if (channelContext->interruptsWanted != InterruptsNone &&
+            ReadNoFence8(&context->recoveryRequested) == 0)
         {
-            DeviceInterruptSet_Locked(context->regs, context->interruptsWanted);
+            DeviceInterruptSet_Locked(context->regs, channel, channelContext->interruptsWanted);
         }
         WdfInterruptReleaseLock(context->interrupt); // HIGH_LEVEL --> DISPATCH_LEVEL
     }
 }
 
+static EVT_WDF_TIMER DeviceTxCompletionTimer;
+static void
+DeviceTxCompletionTimer(_In_ WDFTIMER timer)
+{
+    // DISPATCH_LEVEL
+    auto const context = DeviceGetContext(WdfTimerGetParentObject(timer));
+    unsigned const channel = ChannelDpcGetContext(timer)->channel;
+    auto const channelContext = &context->channels[channel];
+    NT_ASSERT(channelContext->txCompletionTimer == timer);
+
+    // Same as a Tx interrupt: DPC will notify the Tx queue if notification is enabled.
+    ChannelStatus_t status = {};
+    status.Tx = true;
+    channelContext->timerTx += 1;
+    InterlockedOrNoFence(reinterpret_cast<long*>(&channelContext->interruptStatus), status.Value32);
+    WdfDpcEnqueue(channelContext->dpc);
+}
+
 static EVT_WDF_WORKITEM DeviceLinkStateWorkItem;
 static void
 DeviceLinkStateWorkItem(
@@ -456,51 +1038,289 @@ DeviceLinkStateWorkItem(
     }
 }
 
-static EVT_NET_ADAPTER_CREATE_TXQUEUE AdapterCreateTxQueue;
-static NTSTATUS
-AdapterCreateTxQueue(
-    _In_ NETADAPTER adapter,
-    _Inout_ NETTXQUEUE_INIT* queueInit)
-{
-    // PASSIVE_LEVEL, nonpaged (resume path)
-    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
-    NT_ASSERT(context->txQueue == nullptr);
-    return TxQueueCreate(
-        context,
-        context->config,
-        queueInit,
-        context->dma,
-        &context->regs->Dma_Ch[0],
-        &context->regs->Mtl_Q[0]);
-}
+/*
+Fatal error recovery:
+
+Recovery is a PnP restart of the device, WdfDeviceSetFailed(WdfDeviceFailedAttemptRestart),
+not an in-place quiesce/reset of the DMA engine. The driver has no state machine of its
+own that stops the queues, resets the DMA and rebuilds the rings while the adapter stays
+up: the whole device (and the adapter, as seen by the stack) goes away and comes back.
+
+1. DeviceChannelDpc sees FatalBusError, sets recoveryRequested, and leaves the
+   channel's interrupts disabled.
+2. DeviceRecoveryWorkItem saves recoveryStartTime and calls WdfDeviceSetFailed. The
+   restart stops the queues (NetAdapterCx cancels and destroys them), resets the MAC
+   in DeviceReleaseHardware, then runs DevicePrepareHardware (DeviceReset, DMA
+   configuration) and DeviceD0Entry (MAC configuration) again. NetAdapterCx then
+   re-creates the queues (descriptor rings) and restores the packet filter, multicast
+   list and offload settings.
+3. DeviceD0Entry sees recoveryStartTime and updates the recovery counters.
+
+The counters are kept in the device's hardware key because the restart re-creates
+the device object. WDF limits the number of restarts in a short period.
+*/
 
-static EVT_NET_ADAPTER_CREATE_RXQUEUE AdapterCreateRxQueue;
+static DECLARE_CONST_UNICODE_STRING(RecoveriesValueName, L"Recoveries");
+static DECLARE_CONST_UNICODE_STRING(RecoveryMillisecondsValueName, L"RecoveryMilliseconds");
+static DECLARE_CONST_UNICODE_STRING(RecoveryStartTimeValueName, L"RecoveryStartTime");
+
+_IRQL_requires_(PASSIVE_LEVEL)
 static NTSTATUS
-AdapterCreateRxQueue(
-    _In_ NETADAPTER adapter,
-    _Inout_ NETRXQUEUE_INIT* queueInit)
+DeviceRecoveryOpenKey(
+    _In_ WDFDEVICE device,
+    ACCESS_MASK access,
+    _Out_ WDFKEY* key)
 {
     // PASSIVE_LEVEL, nonpaged (resume path)
-    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
-    NT_ASSERT(context->rxQueue == nullptr);
-    return RxQueueCreate(
-        context,
-        context->config,
-        queueInit,
-        context->dma,
-        &context->regs->Dma_Ch[0]);
+    auto const status = WdfDeviceOpenRegistryKey(device, PLUGPLAY_REGKEY_DEVICE, access, WDF_NO_OBJECT_ATTRIBUTES, key);
+    if (!NT_SUCCESS(status))
+    {
+        TraceWrite("WdfDeviceOpenRegistryKey-failed", LEVEL_WARNING,
+            TraceLoggingNTStatus(status));
+    }
+
+    return status;
 }
 
-static EVT_NET_ADAPTER_SET_RECEIVE_FILTER AdapterSetReceiveFilter;
+// Loads the persisted recovery state into the device context.
+_IRQL_requires_(PASSIVE_LEVEL)
 static void
-AdapterSetReceiveFilter(
-    _In_ NETADAPTER adapter,
-    _In_ NETRECEIVEFILTER receiveFilter)
+DeviceRecoveryLoad(
+    _In_ WDFDEVICE device,
+    _Inout_ DeviceContext* context)
 {
-    // PASSIVE_LEVEL, nonpaged (resume path)
-    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
-
-    auto const flags = NetReceiveFilterGetPacketFilter(receiveFilter);
+    // PASSIVE_LEVEL
+    WDFKEY key;
+    if (!NT_SUCCESS(DeviceRecoveryOpenKey(device, KEY_READ, &key)))
+    {
+        return;
+    }
+
+    ULONG value;
+    if (NT_SUCCESS(WdfRegistryQueryULong(key, &RecoveriesValueName, &value)))
+    {
+        context->recoveries = value;
+    }
+
+    if (NT_SUCCESS(WdfRegistryQueryULong(key, &RecoveryMillisecondsValueName, &value)))
+    {
+        context->recoveryMilliseconds = value;
+    }
+
+    UINT64 startTime;
+    ULONG startTimeLength;
+    ULONG startTimeType;
+    if (NT_SUCCESS(WdfRegistryQueryValue(key, &RecoveryStartTimeValueName, sizeof(startTime), &startTime, &startTimeLength, &startTimeType)) &&
+        startTimeType == REG_QWORD &&
+        startTimeLength == sizeof(startTime))
+    {
+        context->recoveryStartTime = startTime;
+    }
+
+    WdfRegistryClose(key);
+}
+
+// Called at the end of DeviceD0Entry after a restart requested by DeviceRecoveryWorkItem.
+_IRQL_requires_(PASSIVE_LEVEL)
+static void
+DeviceRecoveryComplete(
+    _In_ WDFDEVICE device,
+    _Inout_ DeviceContext* context)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const now = KeQueryInterruptTime();
+    auto const startTime = context->recoveryStartTime;
+    context->recoveryStartTime = 0;
+
+    // Ignore a start time from before a reboot.
+    if (startTime <= now)
+    {
+        context->recoveries += 1;
+        context->recoveryMilliseconds = static_cast<UINT32>(min((now - startTime) / 10'000u, 0xFFFFFFFFu));
+    }
+
+    WDFKEY key;
+    if (NT_SUCCESS(DeviceRecoveryOpenKey(device, KEY_READ | KEY_WRITE, &key)))
+    {
+        (void)WdfRegistryAssignULong(key, &RecoveriesValueName, context->recoveries);
+        (void)WdfRegistryAssignULong(key, &RecoveryMillisecondsValueName, context->recoveryMilliseconds);
+        (void)WdfRegistryRemoveValue(key, &RecoveryStartTimeValueName);
+        WdfRegistryClose(key);
+    }
+
+    TraceWrite("DeviceRecoveryComplete", LEVEL_WARNING,
+        TraceLoggingUInt32(context->recoveries, "recoveries"),
+        TraceLoggingUInt32(context->recoveryMilliseconds, "milliseconds"));
+}
+
+static EVT_WDF_WORKITEM DeviceRecoveryWorkItem;
+static void
+DeviceRecoveryWorkItem(
+    _In_ WDFWORKITEM workItem)
+{
+    // PASSIVE_LEVEL, nonpaged
+    auto const device = static_cast<WDFDEVICE>(WdfWorkItemGetParentObject(workItem));
+    auto const context = DeviceGetContext(device);
+    NT_ASSERT(context->recoveryWorkItem == workItem);
+
+    WDFKEY key;
+    if (NT_SUCCESS(DeviceRecoveryOpenKey(device, KEY_WRITE, &key)))
+    {
+        auto startTime = context->recoveryStartTime;
+        (void)WdfRegistryAssignValue(key, &RecoveryStartTimeValueName, REG_QWORD, sizeof(startTime), &startTime);
+        WdfRegistryClose(key);
+    }
+
+    TraceWrite("DeviceRecoveryWorkItem-restart", LEVEL_ERROR,
+        TraceLoggingUInt32(context->recoveries, "recoveries"));
+    WdfDeviceSetFailed(device, WdfDeviceFailedAttemptRestart);
+}
+
+static EVT_NET_ADAPTER_CREATE_TXQUEUE AdapterCreateTxQueue;
+static NTSTATUS
+AdapterCreateTxQueue(
+    _In_ NETADAPTER adapter,
+    _Inout_ NETTXQUEUE_INIT* queueInit)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
+    auto const channel = NetTxQueueInitGetQueueId(queueInit);
+    if (channel >= TxQueuesSupported)
+    {
+        TraceWrite("AdapterCreateTxQueue-bad-id", LEVEL_ERROR,
+            TraceLoggingUInt32(channel));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    NT_ASSERT(context->channels[channel].txQueue == nullptr);
+    return TxQueueCreate(
+        context,
+        context->config,
+        queueInit,
+        context->dma,
+        static_cast<UINT8>(channel),
+        &context->regs->Dma_Ch[channel],
+        &context->regs->Mtl_Q[channel]);
+}
+
+static EVT_NET_ADAPTER_CREATE_RXQUEUE AdapterCreateRxQueue;
+static NTSTATUS
+AdapterCreateRxQueue(
+    _In_ NETADAPTER adapter,
+    _Inout_ NETRXQUEUE_INIT* queueInit)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
+    auto const channel = NetRxQueueInitGetQueueId(queueInit);
+    if (channel >= context->rxQueueCount)
+    {
+        TraceWrite("AdapterCreateRxQueue-bad-id", LEVEL_ERROR,
+            TraceLoggingUInt32(channel));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    NT_ASSERT(context->channels[channel].rxQueue == nullptr);
+    return RxQueueCreate(
+        context,
+        context->config,
+        queueInit,
+        context->dma,
+        static_cast<UINT8>(channel),
+        &context->regs->Dma_Ch[channel]);
+}
+
+static EVT_NET_ADAPTER_RETURN_RX_BUFFER AdapterReturnRxBuffer;
+static void
+AdapterReturnRxBuffer(
+    _In_ NETADAPTER adapter,
+    _In_ NET_FRAGMENT_RETURN_CONTEXT_HANDLE returnContext)
+{
+    // DISPATCH_LEVEL
+    UNREFERENCED_PARAMETER(adapter);
+    RxQueueReturnBuffer(returnContext);
+}
+
+/*
+The EQOS core has no RSS hash engine, so the driver does not claim receive scaling.
+NetAdapterCx is only asked for rxQueueCount Rx queues (RxQueues keyword); without RSS
+it may create fewer. Steering therefore only targets queues that have actually been
+started (DeviceRxQueuesActive): while queue N is not running, nothing is sent to it.
+With more than one active Rx queue, queues are split by traffic class: unicast packets
+are delivered to Rx queue 0 and multicast/broadcast packets are delivered to the last
+active Rx queue. L3/L4 queue filters can move specific flows.
+*/
+
+// Returns the number of Rx queues that steering may use: queues 0..N-1 are started.
+// At least 1, so that queue 0 is the fallback target.
+static UINT8
+DeviceRxQueuesActive(_In_ DeviceContext const* context)
+{
+    // Any IRQL
+    UINT8 count = 0;
+    while (count < context->rxQueueCount &&
+        (context->rxQueuesStarted & (1u << count)))
+    {
+        count += 1;
+    }
+
+    return count > 1 ? count : 1u;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static void
+DeviceRxSteeringSet(_In_ DeviceContext const* context)
+{
+    // DISPATCH_LEVEL
+    auto const rxQueuesActive = DeviceRxQueuesActive(context);
+    MacRxQCtrl1_t rxqCtrl1 = {};
+    if (rxQueuesActive > 1)
+    {
+        rxqCtrl1.MulticastBroadcastQueue = rxQueuesActive - 1u;
+        rxqCtrl1.MulticastBroadcastQueueEnable = true;
+    }
+
+    Write32(&context->regs->Mac_RxQ_Ctrl1, rxqCtrl1);
+
+    TraceWrite("DeviceRxSteeringSet", LEVEL_INFO,
+        TraceLoggingHexInt8(context->rxQueuesStarted, "rxQueuesStarted"),
+        TraceLoggingUInt8(rxQueuesActive));
+}
+
+// True if tagged packets are filtered by VLAN ID (VlanID is set and MAC has VLAN hash).
+static bool
+DeviceVlanFilterEnabled(_In_ DeviceContext const* context)
+{
+    // Any IRQL
+    return context->config.vlanId != 0 && context->feature0.VlanHash;
+}
+
+// True if any L3/L4 filter steers packets to an Rx queue (see DeviceL3L4FilterSet).
+static bool
+DeviceL3L4QueueEnabled(_In_ DeviceContext const* context)
+{
+    // Any IRQL
+    for (auto const& filter : context->config.l3l4Filters)
+    {
+        if (filter.protocol != L3L4FilterProtocolNone &&
+            filter.action != L3L4FilterActionDrop)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static EVT_NET_ADAPTER_SET_RECEIVE_FILTER AdapterSetReceiveFilter;
+static void
+AdapterSetReceiveFilter(
+    _In_ NETADAPTER adapter,
+    _In_ NETRECEIVEFILTER receiveFilter)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    auto const context = DeviceGetContext(AdapterGetContext(adapter)->device);
+
+    auto const flags = NetReceiveFilterGetPacketFilter(receiveFilter);
     auto const mcastCount = (flags & NetPacketFilterFlagMulticast)
         ? NetReceiveFilterGetMulticastAddressCount(receiveFilter)
         : 0;
@@ -517,18 +1337,43 @@ AdapterSetReceiveFilter(
     {
         filter.PassAllMulticast = 0 != (flags & NetPacketFilterFlagAllMulticast);
         filter.DisableBroadcast = 0 == (flags & NetPacketFilterFlagBroadcast);
+        filter.VlanTagFilter = DeviceVlanFilterEnabled(context); // See DeviceD0Entry.
 
         SetOneMacAddress(context->regs, 0, context->currentMacAddress,
-            0 != (flags & NetPacketFilterFlagDirected)); // Address[0] can't really be disabled...
+            0 != (flags & NetPacketFilterFlagDirected), 0); // Address[0] can't really be disabled...
 
-        // Could use hash-based filtering for additional mcast support, but this seems okay.
+        // Multicast addresses use the perfect-match slots first, then the hash table.
+        // Perfect matches select the multicast queue's channel, for when QnDDMACH is set
+        // (see DeviceRxSteeringSet and DeviceD0Entry).
         auto const macAddrCount = context->feature0.MacAddrCount;
         for (unsigned i = 1; i < macAddrCount; i += 1)
         {
             static constexpr UINT8 zero[ETHERNET_LENGTH_OF_ADDRESS] = {};
             bool const enable = mcastCount > i - 1 && mcast[i - 1].Length >= ETHERNET_LENGTH_OF_ADDRESS;
             auto const addr = enable ? mcast[i - 1].Address : zero;
-            SetOneMacAddress(context->regs, i, addr, enable);
+            SetOneMacAddress(context->regs, i, addr, enable, static_cast<UINT8>(DeviceRxQueuesActive(context) - 1u));
+        }
+
+        auto const hashBits = MulticastHashBits(context);
+        if (hashBits != 0)
+        {
+            UINT32 hashTable[ARRAYSIZE(context->regs->MAC_Hash_Table_Reg)] = {};
+            for (auto i = macAddrCount > 1 ? macAddrCount - 1u : 0u; i < mcastCount; i += 1)
+            {
+                if (mcast[i].Length >= ETHERNET_LENGTH_OF_ADDRESS)
+                {
+                    auto const index = MulticastHashIndex(mcast[i].Address, hashBits);
+                    hashTable[index / 32u] |= 1u << (index % 32u);
+                    filter.HashMulticast = true;
+                }
+            }
+
+            // HashPerfectFilter: pass packets that match either the perfect filter or the hash.
+            filter.HashPerfectFilter = filter.HashMulticast;
+            for (unsigned i = 0; i != hashBits / 32u; i += 1)
+            {
+                Write32(&context->regs->MAC_Hash_Table_Reg[i], hashTable[i]);
+            }
         }
     }
 
@@ -536,7 +1381,8 @@ AdapterSetReceiveFilter(
 
     TraceEntryExit(AdapterSetReceiveFilter, LEVEL_INFO,
         TraceLoggingHexInt32(flags),
-        TraceLoggingUIntPtr(mcastCount));
+        TraceLoggingUIntPtr(mcastCount),
+        TraceLoggingBoolean(filter.HashMulticast, "hashMulticast"));
 }
 
 static EVT_NET_ADAPTER_OFFLOAD_SET_TX_CHECKSUM AdapterOffloadSetTxChecksum;
@@ -556,6 +1402,21 @@ AdapterOffloadSetTxChecksum(
         TraceLoggingBoolean(Udp));
 }
 
+static EVT_NET_ADAPTER_OFFLOAD_SET_GSO AdapterOffloadSetGso;
+static void
+AdapterOffloadSetGso(
+    _In_ NETADAPTER adapter,
+    _In_ NETOFFLOAD offload)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    UNREFERENCED_PARAMETER(adapter);
+    auto const IPv4 = NetOffloadIsLsoIPv4Enabled(offload);
+    auto const IPv6 = NetOffloadIsLsoIPv6Enabled(offload);
+    TraceEntryExit(AdapterOffloadSetGso, LEVEL_INFO,
+        TraceLoggingBoolean(IPv4),
+        TraceLoggingBoolean(IPv6));
+}
+
 static EVT_NET_ADAPTER_OFFLOAD_SET_RX_CHECKSUM AdapterOffloadSetRxChecksum;
 static void
 AdapterOffloadSetRxChecksum(
@@ -573,6 +1434,588 @@ AdapterOffloadSetRxChecksum(
         TraceLoggingBoolean(Udp));
 }
 
+// Waits for the self-clearing Mac_Timestamp_Control bits in mask to clear.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PtpWaitForControl(
+    _In_ DeviceContext const* context,
+    UINT32 mask)
+{
+    // DISPATCH_LEVEL
+    for (unsigned retry = 0; retry != 100; retry += 1)
+    {
+        if ((Read32(&context->regs->Mac_Timestamp_Control).Value32 & mask) == 0)
+        {
+            return STATUS_SUCCESS;
+        }
+
+        KeStallExecutionProcessor(1);
+    }
+
+    TraceWrite("PtpWaitForControl-timeout", LEVEL_WARNING,
+        TraceLoggingHexInt32(mask));
+    return STATUS_IO_TIMEOUT;
+}
+
+// Sets the self-clearing Mac_Timestamp_Control bits in update and waits for them to clear.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PtpUpdateControl(
+    _In_ DeviceContext const* context,
+    MacTimestampControl_t update)
+{
+    // DISPATCH_LEVEL
+    auto control = Read32(&context->regs->Mac_Timestamp_Control);
+    control.Value32 |= update.Value32;
+    Write32(&context->regs->Mac_Timestamp_Control, control);
+    return PtpWaitForControl(context, update.Value32);
+}
+
+// Reads the system time. Re-reads if the seconds changed while reading nanoseconds.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static UINT64
+PtpReadTime_Locked(_In_ DeviceContext const* context)
+{
+    // DISPATCH_LEVEL
+    UINT32 seconds, nanoseconds;
+    auto secondsAfter = Read32(&context->regs->Mac_System_Time_Secs);
+    do
+    {
+        seconds = secondsAfter;
+        nanoseconds = Read32(&context->regs->Mac_System_Time_NS);
+        secondsAfter = Read32(&context->regs->Mac_System_Time_Secs);
+    } while (seconds != secondsAfter);
+
+    return seconds * UINT64(NsPerSecond) + nanoseconds;
+}
+
+// Loads the system time, or (if update) adds/subtracts the given time to/from it.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PtpWriteTime_Locked(
+    _In_ DeviceContext const* context,
+    bool update,
+    bool subtract,
+    UINT64 timeNs)
+{
+    // DISPATCH_LEVEL
+    auto seconds = static_cast<UINT32>(timeNs / NsPerSecond);
+    auto nanoseconds = static_cast<UINT32>(timeNs % NsPerSecond);
+    if (subtract)
+    {
+        // Digital rollover: subtract by adding 2^32 - seconds and 10^9 - nanoseconds.
+        seconds = 0u - seconds;
+        nanoseconds = NsPerSecond - nanoseconds;
+    }
+
+    MacSysTimeNsUpdate_t nsUpdate = {};
+    nsUpdate.Nanoseconds = nanoseconds;
+    nsUpdate.Subtract = subtract;
+
+    MacTimestampControl_t busy = {};
+    busy.Initialize = true;
+    busy.Update = true;
+    NTSTATUS status = PtpWaitForControl(context, busy.Value32);
+    if (NT_SUCCESS(status))
+    {
+        Write32(&context->regs->Mac_Sys_Time_Secs_Update, seconds);
+        Write32(&context->regs->Mac_Sys_Time_NS_Update, nsUpdate);
+
+        MacTimestampControl_t control = {};
+        control.Initialize = !update;
+        control.Update = update;
+        status = PtpUpdateControl(context, control);
+    }
+
+    return status;
+}
+
+// Starts the system time generator. Time is initialized from the system clock.
+// Called before PtpSetRunning(true), so ptpLock is not needed.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PtpStart(_Inout_ DeviceContext* context)
+{
+    // DISPATCH_LEVEL
+    NTSTATUS status;
+
+    // Timestamps from before the clock was (re)initialized are meaningless.
+    memset(context->ptpTimestamps, 0, sizeof(context->ptpTimestamps));
+
+    /*
+    Fine update: the accumulator overflows (and time advances by SSINC) at half the
+    reference clock rate, so SSINC = 2 periods and Addend = 2^32 / 2. Adjusting the
+    addend adjusts the rate.
+    */
+    auto const refRate = context->config.ptpRefRate;
+    auto const ssinc = static_cast<UINT32>(min(max(2 * UINT64(NsPerSecond) / refRate, 1u), 0xFFu));
+    auto const addend = static_cast<UINT32>(min(
+        (UINT64(NsPerSecond / ssinc) << 32) / refRate,
+        0xFFFFFFFFu));
+
+    MacTimestampControl_t control = {};
+    control.Enable = true;
+    control.FineUpdate = true;
+    control.DigitalRollover = true;
+    control.PtpVersion2 = true;
+    control.PtpOverEthernet = true;
+    control.PtpOverIPv4 = true;
+    control.PtpOverIPv6 = true;
+    control.EventMessagesOnly = true;
+    control.SnapshotType = TimestampSnapshotType_1;
+    Write32(&context->regs->Mac_Timestamp_Control, control);
+
+    MacSubSecondIncrement_t increment = {};
+    increment.Nanoseconds = ssinc;
+    Write32(&context->regs->Mac_Sub_Second_Increment, increment);
+
+    Write32(&context->regs->Mac_Timestamp_Addend, addend);
+    control = {};
+    control.AddendUpdate = true;
+    status = PtpUpdateControl(context, control);
+    if (!NT_SUCCESS(status))
+    {
+        goto Done;
+    }
+
+    LARGE_INTEGER systemTime;
+    KeQuerySystemTimePrecise(&systemTime);
+    status = PtpWriteTime_Locked(context, false, false,
+        (static_cast<UINT64>(systemTime.QuadPart) - UnixEpochAsFileTime) * 100u);
+    if (!NT_SUCCESS(status))
+    {
+        goto Done;
+    }
+
+    context->ptpAddendBase = addend;
+
+Done:
+
+    TraceEntryExitWithStatus(PtpStart, LEVEL_INFO, status,
+        TraceLoggingUInt32(refRate),
+        TraceLoggingUInt32(ssinc),
+        TraceLoggingHexInt32(addend));
+    return status;
+}
+
+// Enables or disables the PTP interface functions. Waits for in-progress calls.
+_IRQL_requires_max_(PASSIVE_LEVEL)
+static void
+PtpSetRunning(
+    _Inout_ DeviceContext* context,
+    bool running)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    WdfSpinLockAcquire(context->ptpLock); // PASSIVE_LEVEL --> DISPATCH_LEVEL
+    context->ptpRunning = running;
+    WdfSpinLockRelease(context->ptpLock); // DISPATCH_LEVEL --> PASSIVE_LEVEL
+}
+
+// Common prologue for the PTP interface functions. On success, ptpLock is held.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+static NTSTATUS
+PtpAcquire(_Inout_ DeviceContext* context)
+{
+    // DISPATCH_LEVEL
+    if (!context->config.ptpTimestamp)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    WdfSpinLockAcquire(context->ptpLock);
+    if (!context->ptpRunning)
+    {
+        WdfSpinLockRelease(context->ptpLock);
+        return STATUS_DEVICE_NOT_READY;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+PtpGetTime(
+    _In_ PVOID interfaceContext,
+    _Out_ UINT64* timeNs)
+{
+    // DISPATCH_LEVEL
+    auto const context = static_cast<DeviceContext*>(interfaceContext);
+    *timeNs = 0;
+    NTSTATUS status = PtpAcquire(context);
+    if (NT_SUCCESS(status))
+    {
+        *timeNs = PtpReadTime_Locked(context);
+        WdfSpinLockRelease(context->ptpLock);
+    }
+
+    return status;
+}
+
+static NTSTATUS
+PtpSetTime(
+    _In_ PVOID interfaceContext,
+    UINT64 timeNs)
+{
+    // DISPATCH_LEVEL
+    auto const context = static_cast<DeviceContext*>(interfaceContext);
+    NTSTATUS status = PtpAcquire(context);
+    if (NT_SUCCESS(status))
+    {
+        status = PtpWriteTime_Locked(context, false, false, timeNs);
+        WdfSpinLockRelease(context->ptpLock);
+    }
+
+    TraceEntryExitWithStatus(PtpSetTime, LEVEL_INFO, status,
+        TraceLoggingUInt64(timeNs));
+    return status;
+}
+
+static NTSTATUS
+PtpAdjustTime(
+    _In_ PVOID interfaceContext,
+    INT64 deltaNs)
+{
+    // DISPATCH_LEVEL
+    auto const context = static_cast<DeviceContext*>(interfaceContext);
+    NTSTATUS status = PtpAcquire(context);
+    if (NT_SUCCESS(status))
+    {
+        status = PtpWriteTime_Locked(context, true, deltaNs < 0,
+            deltaNs < 0 ? 0u - static_cast<UINT64>(deltaNs) : static_cast<UINT64>(deltaNs));
+        WdfSpinLockRelease(context->ptpLock);
+    }
+
+    TraceEntryExitWithStatus(PtpAdjustTime, LEVEL_VERBOSE, status,
+        TraceLoggingInt64(deltaNs));
+    return status;
+}
+
+static NTSTATUS
+PtpAdjustFrequency(
+    _In_ PVOID interfaceContext,
+    INT32 ppb)
+{
+    // DISPATCH_LEVEL
+    auto const context = static_cast<DeviceContext*>(interfaceContext);
+    if (ppb <= -INT32(NsPerSecond) || ppb >= INT32(NsPerSecond))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    NTSTATUS status = PtpAcquire(context);
+    if (NT_SUCCESS(status))
+    {
+        auto const base = static_cast<INT64>(context->ptpAddendBase);
+        auto const addend = base + base * ppb / INT64(NsPerSecond);
+        if (addend <= 0 || addend > 0xFFFFFFFF)
+        {
+            status = STATUS_INVALID_PARAMETER;
+        }
+        else
+        {
+            Write32(&context->regs->Mac_Timestamp_Addend, static_cast<UINT32>(addend));
+            MacTimestampControl_t control = {};
+            control.AddendUpdate = true;
+            status = PtpUpdateControl(context, control);
+        }
+
+        WdfSpinLockRelease(context->ptpLock);
+    }
+
+    TraceEntryExitWithStatus(PtpAdjustFrequency, LEVEL_VERBOSE, status,
+        TraceLoggingInt32(ppb));
+    return status;
+}
+
+static NTSTATUS
+PtpGetPacketTimestamp(
+    _In_ PVOID interfaceContext,
+    BOOLEAN transmit,
+    UINT8 messageType,
+    UINT16 sequenceId,
+    _Out_ UINT64* timeNs)
+{
+    // DISPATCH_LEVEL
+    auto const context = static_cast<DeviceContext*>(interfaceContext);
+    *timeNs = 0;
+    if (!context->config.ptpTimestamp)
+    {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    NTSTATUS status = STATUS_NOT_FOUND;
+    WdfSpinLockAcquire(context->ptpLock);
+    for (auto& entry : context->ptpTimestamps[transmit != 0])
+    {
+        if (entry.timeNs != 0 &&
+            entry.id.messageType == messageType &&
+            entry.id.sequenceId == sequenceId)
+        {
+            *timeNs = entry.timeNs;
+            entry.timeNs = 0;
+            status = STATUS_SUCCESS;
+            break;
+        }
+    }
+    WdfSpinLockRelease(context->ptpLock);
+
+    return status;
+}
+
+/*
+L3/L4 filters match TCP or UDP packets by destination port.
+- Queue filters (optionally also matching an IPv4 destination prefix) route matching
+  packets to the filter's Rx DMA channel. The MAC only does this for MTL queues with
+  QnDDMACH set (see DeviceD0Entry).
+- Drop filters match the port normally and RxQueueAdvance drops the packets that the
+  MAC reports as matching them. MAC_Packet_Filter.IPFE is not used: it drops every IP
+  packet that matches none of the enabled filters, e.g. all UDP and ICMP traffic when
+  the only filter is a TCP drop filter. An inverse match can't fix that.
+The MAC reports the matching filter in RDES2 and RxQueueAdvance counts the matches.
+*/
+static void
+DeviceL3L4FilterSet(
+    _Inout_ DeviceContext* context,
+    unsigned index,
+    _In_ L3L4Filter const& filter)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    NT_ASSERT(index < L3L4FiltersMax);
+    auto const filterRegs = &context->regs->Mac_L3_L4[index];
+
+    MacL3L4Control_t control = {};
+    MacLayer4Address_t layer4 = {};
+    UINT32 address = 0;
+    if (filter.protocol != L3L4FilterProtocolNone)
+    {
+        bool const drop = filter.action == L3L4FilterActionDrop;
+        control.L4ProtocolUdp = filter.protocol == L3L4FilterProtocolUdp;
+        control.L4DestPortMatch = true;
+        layer4.DestPort = filter.port;
+
+        if (!drop)
+        {
+            if (filter.addressPrefix != 0)
+            {
+                control.L3DestMatch = true;
+                control.L3DestMaskBits = 32u - filter.addressPrefix;
+                address = filter.address;
+            }
+
+            // A queue that is not running gets nothing; its flow goes to queue 0.
+            auto const queue = static_cast<unsigned>(filter.action - L3L4FilterActionQueue0);
+            control.DmaChannelEnable = true;
+            control.DmaChannel = queue < DeviceRxQueuesActive(context) ? queue : 0u;
+        }
+    }
+
+    // Disable the filter while it is being updated.
+    Write32(&filterRegs->L3_L4_Control, MacL3L4Control_t{});
+    Write32(&filterRegs->Layer3_Addr1_Reg, address);
+    Write32(&filterRegs->Layer4_Address, layer4);
+    Write32(&filterRegs->L3_L4_Control, control);
+
+    TraceWrite("DeviceL3L4FilterSet", LEVEL_INFO,
+        TraceLoggingUInt32(index),
+        TraceLoggingHexInt32(control.Value32, "control"),
+        TraceLoggingHexInt32(layer4.Value32, "layer4"),
+        TraceLoggingHexInt32(address, "address"));
+}
+
+/*
+Power management offloads, armed by DeviceD0Exit when leaving D0 for a low-power state:
+- ARP offload: the MAC answers ARP requests for Mac_Arp_Address without involving the
+  host.
+- Magic packet and bitmap pattern wake: the MAC enters power-down mode, drops other
+  packets, and raises the PMT interrupt when it receives a wake-up packet.
+A remote wake-up filter matches up to 31 masked bytes at an 8-bit offset. Pattern bytes
+in the destination address are not matched (the MAC address filter still applies in
+power-down mode) but select the filter's address type.
+*/
+
+// Converts an NDIS bitmap pattern to remote wake-up filter 'index'. Returns false if the
+// pattern does not fit in a filter.
+static bool
+PmtWakeFilterSet(
+    _Inout_ MacRwkFilterBlock* filters,
+    unsigned index,
+    _In_ NET_WAKE_SOURCE_BITMAP_PARAMETERS const& bitmap)
+{
+    // Any IRQL
+    NT_ASSERT(index < PmtWakeFiltersMax);
+    auto const patternSize = static_cast<UINT32>(
+        min(min(bitmap.PatternSize, bitmap.MaskSize * 8u), PmtWakePatternSizeMax));
+
+    UINT32 first = MAXUINT32;
+    UINT32 last = 0;
+    bool multicast = false;
+    for (UINT32 i = 0; i != patternSize; i += 1)
+    {
+        if (0 == (bitmap.Mask[i / 8u] & (1u << (i % 8u))))
+        {
+            continue;
+        }
+
+        if (i < ETHERNET_LENGTH_OF_ADDRESS)
+        {
+            multicast |= i == 0 && ETH_IS_MULTICAST(bitmap.Pattern); // Includes broadcast.
+            continue;
+        }
+
+        first = min(first, i);
+        last = i;
+    }
+
+    if (first == MAXUINT32 || first > 0xFF || last - first >= PmtWakeFilterBytes)
+    {
+        return false;
+    }
+
+    // CRC-16 (x^16 + x^15 + x^2 + 1, LSB first) of the masked bytes.
+    UINT32 byteMask = 0;
+    UINT32 crc = 0xFFFF;
+    for (UINT32 i = first; i <= last; i += 1)
+    {
+        if (bitmap.Mask[i / 8u] & (1u << (i % 8u)))
+        {
+            byteMask |= 1u << (i - first);
+            crc ^= bitmap.Pattern[i];
+            for (unsigned bit = 0; bit != 8; bit += 1)
+            {
+                crc = (crc >> 1) ^ (0xA001 & (0u - (crc & 1)));
+            }
+        }
+    }
+
+    filters->ByteMask[index] = byteMask;
+    filters->Command[index] = static_cast<UINT8>(multicast
+        ? MacRwkFilterCommand_Enable | MacRwkFilterCommand_Multicast
+        : MacRwkFilterCommand_Enable);
+    filters->Offset[index] = static_cast<UINT8>(first);
+    filters->Crc16[index] = static_cast<UINT16>(crc);
+    return true;
+}
+
+static EVT_WDF_INTERRUPT_ISR DevicePmtInterruptIsr;
+static BOOLEAN
+DevicePmtInterruptIsr(
+    _In_ WDFINTERRUPT interrupt,
+    _In_ ULONG messageId)
+{
+    // HIGH_LEVEL
+    UNREFERENCED_PARAMETER(messageId);
+    auto const context = DeviceGetContext(WdfInterruptGetDevice(interrupt));
+    auto const pmt = Read32(&context->regs->Mac_Pmt_Control_Status); // Clears MGKPRCVD and RWKPRCVD.
+    if (!pmt.MagicPacketReceived && !pmt.RemoteWakeReceived)
+    {
+        return false;
+    }
+
+    context->pmtWakes += 1;
+    return true;
+}
+
+// Programs the power offloads and wake sources that NetAdapterCx has enabled, then
+// leaves the MAC in the corresponding low-power state. Called after the MAC is stopped.
+_IRQL_requires_(PASSIVE_LEVEL)
+__declspec(code_seg("PAGE"))
+static void
+DevicePmtArm(
+    _In_ WDFDEVICE device,
+    _Inout_ DeviceContext* context)
+{
+    // PASSIVE_LEVEL
+    PAGED_CODE();
+    auto const regs = context->regs;
+    UINT32 arpAddress = 0;
+    MacPmtControlStatus_t pmt = {};
+    MacRwkFilterBlock filters = {};
+    unsigned filterCount = 0;
+
+    NET_POWER_OFFLOAD_LIST offloadList;
+    NET_POWER_OFFLOAD_LIST_INIT(&offloadList);
+    NetDeviceGetPowerOffloadList(device, &offloadList);
+    for (SIZE_T i = 0; i != NetPowerOffloadListGetCount(&offloadList); i += 1)
+    {
+        auto const offload = NetPowerOffloadListGetElement(&offloadList, i);
+        if (NetPowerOffloadGetType(offload) == NetPowerOffloadTypeArp)
+        {
+            NET_POWER_OFFLOAD_ARP_PARAMETERS arp;
+            NET_POWER_OFFLOAD_ARP_PARAMETERS_INIT(&arp);
+            NetPowerOffloadGetArpParameters(offload, &arp);
+            arpAddress = RtlUlongByteSwap(arp.HostIPv4Address.S_un.S_addr); // First octet in the high byte.
+        }
+    }
+
+    NET_WAKE_SOURCE_LIST wakeList;
+    NET_WAKE_SOURCE_LIST_INIT(&wakeList);
+    NetDeviceGetWakeSourceList(device, &wakeList);
+    for (SIZE_T i = 0; i != NetWakeSourceListGetCount(&wakeList); i += 1)
+    {
+        auto const source = NetWakeSourceListGetElement(&wakeList, i);
+        switch (NetWakeSourceGetType(source))
+        {
+        case NetWakeSourceTypeMagicPacket:
+            pmt.MagicPacketEnable = true;
+            break;
+
+        case NetWakeSourceTypeBitmapPattern:
+        {
+            NET_WAKE_SOURCE_BITMAP_PARAMETERS bitmap;
+            NET_WAKE_SOURCE_BITMAP_PARAMETERS_INIT(&bitmap);
+            NetWakeSourceGetBitmapParameters(source, &bitmap);
+            if (filterCount != PmtWakeFiltersMax &&
+                PmtWakeFilterSet(&filters, filterCount, bitmap))
+            {
+                filterCount += 1;
+            }
+            else
+            {
+                TraceWrite("DevicePmtArm-pattern-unsupported", LEVEL_WARNING,
+                    TraceLoggingUInt32(bitmap.Id, "id"),
+                    TraceLoggingUInt64(bitmap.PatternSize, "patternSize"));
+            }
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    if (filterCount != 0)
+    {
+        MacPmtControlStatus_t reset = {};
+        reset.RemoteWakeFilterReset = true;
+        Write32(&regs->Mac_Pmt_Control_Status, reset);
+
+        auto const words = reinterpret_cast<UINT32 const*>(&filters);
+        for (unsigned i = 0; i != sizeof(filters) / sizeof(UINT32); i += 1)
+        {
+            Write32(&regs->Mac_Rwk_Packet_Filter, words[i]);
+        }
+
+        pmt.RemoteWakeEnable = true;
+    }
+
+    pmt.PowerDown = pmt.MagicPacketEnable || pmt.RemoteWakeEnable;
+    if (arpAddress != 0 || pmt.PowerDown)
+    {
+        // The receiver must be enabled for power-down mode. ARP replies need the transmitter.
+        Write32(&regs->Mac_Arp_Address, arpAddress);
+        auto macConfig = Read32(&regs->Mac_Configuration);
+        macConfig.ArpOffloadEnable = arpAddress != 0;
+        macConfig.TransmitterEnable = arpAddress != 0;
+        macConfig.ReceiverEnable = true;
+        Write32(&regs->Mac_Configuration, macConfig);
+        Write32(&regs->Mac_Pmt_Control_Status, pmt);
+    }
+
+    TraceEntryExit(DevicePmtArm, LEVEL_INFO,
+        TraceLoggingHexInt32(arpAddress),
+        TraceLoggingUInt32(filterCount),
+        TraceLoggingHexInt32(pmt.Value32, "pmt"));
+}
+
 static EVT_WDF_DEVICE_D0_ENTRY DeviceD0Entry;
 static NTSTATUS
 DeviceD0Entry(
@@ -583,42 +2026,66 @@ DeviceD0Entry(
     NTSTATUS status = STATUS_SUCCESS;
     auto const context = DeviceGetContext(device);
 
+    // Leave power-down mode (see DevicePmtArm). Reading clears the wake-up status.
+
+    auto const pmt = Read32(&context->regs->Mac_Pmt_Control_Status);
+    Write32(&context->regs->Mac_Pmt_Control_Status, MacPmtControlStatus_t{});
+
     // TX configuration.
 
     UINT32 const txFifoSize =
         context->feature1.TxFifoSize > 23 ? 0x80000000 // Probably can't happen.
         : 128u << context->feature1.TxFifoSize; // RK3588 has 16KB.
     UINT32 const txQueueSize =
-        txFifoSize / QueuesSupported > 0x100000 ? 0x100000 // QueueSize field can express up to 1MB (assuming that 6 Reserved bits are actually QueueSize).
-        : txFifoSize / QueuesSupported;
+        txFifoSize / TxQueuesSupported > 0x100000 ? 0x100000 // QueueSize field can express up to 1MB (assuming that 6 Reserved bits are actually QueueSize).
+        : txFifoSize / TxQueuesSupported;
 
+    // The pause time is the maximum: when the Rx queue drains, the MAC cancels the
+    // pause with a zero-quanta pause frame.
     MacTxFlowCtrl_t txFlowCtrl = {};
-    txFlowCtrl.TransmitFlowControlEnable = true;
+    txFlowCtrl.TransmitFlowControlEnable = 0 != (context->config.flowControl & FlowControlTxPause);
     txFlowCtrl.PauseTime = 0xFFFF;
     Write32(&context->regs->Mac_Tx_Flow_Ctrl, txFlowCtrl); // TxFlow control, pause time.
 
     MtlTxOperationMode_t txOperationMode = {};
-    txOperationMode.StoreAndForward = true;
+    txOperationMode.StoreAndForward = context->config.txThreshold == 0;
+    txOperationMode.ThresholdControl = TxThresholdControl(context->config.txThreshold);
     txOperationMode.QueueEnable = MtlTxQueueEnable_Enabled;
     txOperationMode.QueueSize = txQueueSize / 256u - 1;
-    Write32(&context->regs->Mtl_Q[0].Tx_Operation_Mode, txOperationMode);
+    for (unsigned queue = 0; queue != TxQueuesSupported; queue += 1)
+    {
+        Write32(&context->regs->Mtl_Q[queue].Tx_Operation_Mode, txOperationMode);
+    }
 
     // RX configuration.
 
-    UINT32 const rxFifoSize =
-        context->feature1.RxFifoSize > 23 ? 0x80000000 // Probably can't happen.
-        : 128u << context->feature1.RxFifoSize; // RK3588 has 32KB.
-    UINT32 const rxQueueSize =
-        rxFifoSize / QueuesSupported > 0x100000 ? 0x100000 // QueueSize field can express up to 1MB (assuming that the 5 Reserved bits are actually QueueSize).
-        : rxFifoSize / QueuesSupported;
-    UINT32 const rxFlowControlActivate =
-        rxQueueSize < 65536 ? rxQueueSize / 2u  // Limited queue: pause when 1/2 remains.
-        : 32768u;                               // Large queue: pause when 32KB remains.
-    UINT32 const rxFlowControlDeactivate =
-        rxFlowControlActivate + rxFlowControlActivate / 2u; // Unpause when 3/4 or 48KB remains.
-
-    Write32(&context->regs->Mac_Rx_Flow_Ctrl, 0x3); // Rx flow control, pause packet detect.
-    Write32(&context->regs->Mac_RxQ_Ctrl0, 0x2); // RxQ0 enabled for DCB/generic.
+    // Flow control thresholds assume 1 Gbps until UpdateLinkState sees the link speed.
+    auto const rxQueueCount = context->rxQueueCount;
+    UINT32 const rxQueueSize = RxQueueFifoSize(context);
+    UINT32 rxFlowControlActivate, rxFlowControlDeactivate;
+    RxFlowControlThresholds(context, rxQueueSize, 1'000'000'000u, &rxFlowControlActivate, &rxFlowControlDeactivate);
+
+    Write32(&context->regs->Mac_Rx_Flow_Ctrl,
+        (context->config.flowControl & FlowControlRxPause) ? 0x3u : 0u); // Rx flow control, pause packet detect.
+
+    static_assert(ChannelsMax == 2, "Update RxQ_Ctrl0 and RxQ_Dma_Map0 for more channels.");
+    MacRxQCtrl0_t rxqCtrl0 = {};
+    rxqCtrl0.RxQ0Enable = MacRxQueueEnable_EnabledDcb;
+    rxqCtrl0.RxQ1Enable = rxQueueCount > 1 ? MacRxQueueEnable_EnabledDcb : MacRxQueueEnable_Disabled;
+    Write32(&context->regs->Mac_RxQ_Ctrl0, rxqCtrl0);
+
+    MtlRxQDmaMap0_t rxqDmaMap = {}; // RxQ N --> DMA channel N.
+    rxqDmaMap.Q0Channel = 0;
+    rxqDmaMap.Q1Channel = 1;
+    if (DeviceL3L4QueueEnabled(context))
+    {
+        // Let queue filters (and the DA filter's DCS) pick the channel, see DeviceL3L4FilterSet.
+        rxqDmaMap.Q0DynamicChannel = true;
+        rxqDmaMap.Q1DynamicChannel = true;
+    }
+    Write32(&context->regs->Mtl_RxQ_Dma_Map0, rxqDmaMap);
+
+    DeviceRxSteeringSet(context);
 
     MtlRxOperationMode_t rxOperationMode = {};
     rxOperationMode.StoreAndForward = true;
@@ -626,10 +2093,13 @@ DeviceD0Entry(
     rxOperationMode.ForwardErrorPackets = false;
     rxOperationMode.ForwardUndersizedGoodPackets = true;
     rxOperationMode.QueueSize = rxQueueSize / 256u - 1;
-    rxOperationMode.HardwareFlowControl = rxQueueSize >= 2048;
-    rxOperationMode.FlowControlActivate = (rxFlowControlActivate / 512u) - 2u;
-    rxOperationMode.FlowControlDeactivate = (rxFlowControlDeactivate / 512u) - 2u;
-    Write32(&context->regs->Mtl_Q[0].Rx_Operation_Mode, rxOperationMode);
+    rxOperationMode.HardwareFlowControl = rxQueueSize >= 2048 && (context->config.flowControl & FlowControlTxPause);
+    rxOperationMode.FlowControlActivate = (rxFlowControlActivate / RxFlowControlUnit) - 2u;
+    rxOperationMode.FlowControlDeactivate = (rxFlowControlDeactivate / RxFlowControlUnit) - 2u;
+    for (unsigned queue = 0; queue != rxQueueCount; queue += 1)
+    {
+        Write32(&context->regs->Mtl_Q[queue].Rx_Operation_Mode, rxOperationMode);
+    }
 
     // MAC configuration.
 
@@ -639,20 +2109,81 @@ DeviceD0Entry(
     macConfig.ReceiverEnable = true;
     macConfig.TransmitterEnable = true;
     macConfig.ChecksumOffloadEnable = context->config.txCoeSel || context->config.rxCoeSel;
+    macConfig.JumboPacketEnable = context->config.jumboPacket > JumboPacketMin;
     Write32(&context->regs->Mac_Configuration, macConfig);
 
+    // VLAN: strip Rx tags and report them in the descriptor, insert Tx tags from the
+    // context descriptor, and (if VlanID is set) pass only tagged packets for VlanID
+    // or priority-only tags (VLAN ID 0).
+
+    MacVlanTagCtrl_t vlanTagCtrl = {};
+    if (context->config.priorityVlanTag != 0)
+    {
+        vlanTagCtrl.StripOnReceive = VlanStripOnReceive_Always;
+        vlanTagCtrl.EnableRxStatus = true;
+    }
+
+    if (DeviceVlanFilterEnabled(context))
+    {
+        vlanTagCtrl.Enable12BitVlanCompare = true;
+        vlanTagCtrl.VlanHashMatch = true;
+        Write32(&context->regs->Mac_Vlan_Hash_Table,
+            (1u << VlanHashIndex(0)) | (1u << VlanHashIndex(context->config.vlanId)));
+    }
+
+    Write32(&context->regs->Mac_Vlan_Tag_Ctrl, vlanTagCtrl);
+
+    MacVlanIncl_t vlanIncl = {};
+    vlanIncl.VlanTagInput = context->config.priorityVlanTag != 0;
+    Write32(&context->regs->Mac_Vlan_Incl, vlanIncl);
+
+    if (context->config.rxSplitHeader)
+    {
+        auto macExtConfig = Read32(&context->regs->Mac_Ext_Configuration);
+        macExtConfig.HeaderSplitMaxSize = SplitHeaderMaxSize256;
+        Write32(&context->regs->Mac_Ext_Configuration, macExtConfig);
+    }
+
+    for (unsigned i = 0; i != min(context->feature1.L3L4Filters, L3L4FiltersMax); i += 1)
+    {
+        DeviceL3L4FilterSet(context, i, context->config.l3l4Filters[i]);
+    }
+
+    // IEEE 1588 clock. Failure is not fatal: the interface just reports not ready.
+
+    if (context->config.ptpTimestamp &&
+        NT_SUCCESS(PtpStart(context)))
+    {
+        PtpSetRunning(context, true);
+    }
+
+    if (context->config.eee)
+    {
+        DeviceEeeAdvertise(context);
+    }
+
     // Clear any pending interrupts, then unmask them.
 
     NT_ASSERT(ReadNoFence8(&context->updateLinkStateBusy) == 0);
     UpdateLinkState(context); // Clears LinkStatus interrupt.
-    Write32(&context->regs->Dma_Ch[0].Status, ChannelStatus_t(~0u));
+    for (unsigned channel = 0; channel != rxQueueCount; channel += 1)
+    {
+        Write32(&context->regs->Dma_Ch[channel].Status, ChannelStatus_t(~0u));
 
-    NT_ASSERT(context->interruptsWanted == InterruptsNone);
-    context->interruptsWanted = InterruptsState;
-    DeviceInterruptSet_Locked(context->regs, InterruptsState); // Interrupts are disabled so interrupt lock is offline.
+        NT_ASSERT(context->channels[channel].interruptsWanted == InterruptsNone);
+        context->channels[channel].interruptsWanted = InterruptsState;
+        DeviceInterruptSet_Locked(context->regs, channel, InterruptsState); // Interrupts are disabled so interrupt lock is offline.
+    }
+
+    if (context->recoveryStartTime != 0)
+    {
+        DeviceRecoveryComplete(device, context);
+    }
 
     TraceEntryExitWithStatus(DeviceD0Entry, LEVEL_INFO, status,
         TraceLoggingUInt32(previousState),
+        TraceLoggingHexInt32(pmt.Value32, "pmt"),
+        TraceLoggingUInt8(rxQueueCount),
         TraceLoggingHexInt32(txQueueSize),
         TraceLoggingHexInt32(rxQueueSize),
         TraceLoggingHexInt32(rxFlowControlActivate),
@@ -672,23 +2203,158 @@ DeviceD0Exit(
     NTSTATUS status = STATUS_SUCCESS;
     auto const context = DeviceGetContext(device);
 
-    DeviceInterruptSet_Locked(context->regs, InterruptsNone); // Interrupts are disabled so interrupt lock is offline.
-    context->interruptsWanted = InterruptsNone;
+    for (unsigned channel = 0; channel != context->rxQueueCount; channel += 1)
+    {
+        auto const channelContext = &context->channels[channel];
+        DeviceInterruptSet_Locked(context->regs, channel, InterruptsNone); // Interrupts are disabled so interrupt lock is offline.
+        channelContext->interruptsWanted = InterruptsNone;
+        WdfTimerStop(channelContext->txCompletionTimer, true);
+        WdfDpcCancel(channelContext->dpc, true);
+        channelContext->interruptStatus.Value32 = 0;
+    }
+
+    WdfWorkItemFlush(context->updateLinkStateWorkItem);
+    NT_ASSERT(ReadNoFence8(&context->updateLinkStateBusy) == 0);
+    WdfWorkItemFlush(context->recoveryWorkItem);
+
+    if (context->config.ptpTimestamp)
+    {
+        PtpSetRunning(context, false);
+    }
+
+    for (auto const& channelContext : context->channels)
+    {
+        NT_ASSERT(channelContext.txQueue == nullptr);
+        NT_ASSERT(channelContext.rxQueue == nullptr);
+        UNREFERENCED_PARAMETER(channelContext);
+    }
+
+    if (context->config.eee)
+    {
+        Write32(&context->regs->Mac_Lpi_Control_Status, MacLpiControlStatus_t{});
+    }
+
+    auto macConfig = Read32(&context->regs->Mac_Configuration);
+    macConfig.ReceiverEnable = false;
+    macConfig.TransmitterEnable = false;
+    Write32(&context->regs->Mac_Configuration, macConfig);
+
+    if (targetState != WdfPowerDeviceD3Final)
+    {
+        DevicePmtArm(device, context);
+    }
+
+    TraceEntryExitWithStatus(DeviceD0Exit, LEVEL_INFO, status,
+        TraceLoggingUInt32(targetState));
+    return status;
+}
+
+// Reads the L3L4FilterN* keywords. Returns a disabled filter if the filter is not
+// configured or a keyword is invalid.
+_IRQL_requires_(PASSIVE_LEVEL)
+__declspec(code_seg("PAGE"))
+static L3L4Filter
+DeviceL3L4FilterQuery(
+    _In_ NETCONFIGURATION configuration,
+    unsigned index)
+{
+    // PASSIVE_LEVEL
+    PAGED_CODE();
+    static_assert(L3L4FiltersMax == 2, "Add keyword names for more L3/L4 filters.");
+    NT_ASSERT(index < L3L4FiltersMax);
+
+    DECLARE_CONST_UNICODE_STRING(protocol0Name, L"L3L4Filter0Protocol");
+    DECLARE_CONST_UNICODE_STRING(protocol1Name, L"L3L4Filter1Protocol");
+    DECLARE_CONST_UNICODE_STRING(port0Name, L"L3L4Filter0Port");
+    DECLARE_CONST_UNICODE_STRING(port1Name, L"L3L4Filter1Port");
+    DECLARE_CONST_UNICODE_STRING(action0Name, L"L3L4Filter0Action");
+    DECLARE_CONST_UNICODE_STRING(action1Name, L"L3L4Filter1Action");
+    DECLARE_CONST_UNICODE_STRING(address0Name, L"L3L4Filter0Address");
+    DECLARE_CONST_UNICODE_STRING(address1Name, L"L3L4Filter1Address");
+
+    NTSTATUS status;
+    L3L4Filter filter = {};
+    ULONG protocol = L3L4FilterProtocolNone;
+    ULONG port = 0;
+    ULONG action = L3L4FilterActionDrop;
+    WDFSTRING addressString = nullptr;
+
+    status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+        index == 0 ? &protocol0Name : &protocol1Name, &protocol);
+    if (!NT_SUCCESS(status) || protocol == L3L4FilterProtocolNone)
+    {
+        goto Done;
+    }
+
+    (void)NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+        index == 0 ? &port0Name : &port1Name, &port);
+    (void)NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS,
+        index == 0 ? &action0Name : &action1Name, &action);
+    if (protocol > L3L4FilterProtocolUdp ||
+        port == 0 || port > 0xFFFF ||
+        action >= L3L4FilterActionQueue0 + ChannelsMax)
+    {
+        TraceWrite("DeviceL3L4FilterQuery-bad-config", LEVEL_WARNING,
+            TraceLoggingUInt32(index),
+            TraceLoggingUInt32(protocol),
+            TraceLoggingUInt32(port),
+            TraceLoggingUInt32(action));
+        goto Done;
+    }
+
+    filter.protocol = static_cast<L3L4FilterProtocol>(protocol);
+    filter.action = static_cast<L3L4FilterAction>(action);
+    filter.port = static_cast<UINT16>(port);
 
-    WdfWorkItemFlush(context->updateLinkStateWorkItem);
-    NT_ASSERT(ReadNoFence8(&context->updateLinkStateBusy) == 0);
+    // Optional "a.b.c.d" or "a.b.c.d/prefix".
+    status = NetConfigurationQueryString(configuration, WDF_NO_OBJECT_ATTRIBUTES,
+        index == 0 ? &address0Name : &address1Name, &addressString);
+    if (NT_SUCCESS(status))
+    {
+        UNICODE_STRING addressUnicode;
+        WdfStringGetUnicodeString(addressString, &addressUnicode);
 
-    NT_ASSERT(context->txQueue == nullptr);
-    NT_ASSERT(context->rxQueue == nullptr);
+        WCHAR text[20] = {}; // "255.255.255.255/32"
+        auto const textLength = addressUnicode.Length / sizeof(WCHAR);
+        if (textLength != 0 && textLength < ARRAYSIZE(text))
+        {
+            memcpy(text, addressUnicode.Buffer, textLength * sizeof(WCHAR));
 
-    auto macConfig = Read32(&context->regs->Mac_Configuration);
-    macConfig.ReceiverEnable = false;
-    macConfig.TransmitterEnable = false;
-    Write32(&context->regs->Mac_Configuration, macConfig);
+            IN_ADDR address;
+            PCWSTR terminator;
+            ULONG prefix = 32;
+            status = RtlIpv4StringToAddressW(text, TRUE, &terminator, &address);
+            if (NT_SUCCESS(status) && *terminator == L'/')
+            {
+                prefix = 0;
+                for (terminator += 1; *terminator >= L'0' && *terminator <= L'9'; terminator += 1)
+                {
+                    prefix = prefix * 10 + (*terminator - L'0');
+                }
+            }
 
-    TraceEntryExitWithStatus(DeviceD0Exit, LEVEL_INFO, status,
-        TraceLoggingUInt32(targetState));
-    return status;
+            if (!NT_SUCCESS(status) || *terminator != 0 || prefix == 0 || prefix > 32)
+            {
+                TraceWrite("DeviceL3L4FilterQuery-bad-address", LEVEL_WARNING,
+                    TraceLoggingUInt32(index),
+                    TraceLoggingCountedWideString(addressUnicode.Buffer, static_cast<UINT16>(textLength), "address"));
+            }
+            else
+            {
+                filter.address = RtlUlongByteSwap(address.S_un.S_addr);
+                filter.addressPrefix = static_cast<UINT8>(prefix);
+            }
+        }
+    }
+
+Done:
+
+    if (addressString != nullptr)
+    {
+        WdfObjectDelete(addressString);
+    }
+
+    return filter;
 }
 
 static EVT_WDF_DEVICE_PREPARE_HARDWARE DevicePrepareHardware;
@@ -707,6 +2373,21 @@ DevicePrepareHardware(
     PHYSICAL_ADDRESS maxPhysicalAddress;
     auto const context = DeviceGetContext(device);
     bool configHasMacAddress = false;
+    ULONG configRxQueues = 1;
+    ULONG configJumboPacket = JumboPacketMin;
+    ULONG configRxInterruptModeration = RxInterruptModerationBalanced;
+    ULONG configRxCopyBreak = RxCopyBreakDefault;
+    ULONG configHeaderDataSplit = 0;
+    ULONG configPtpHardwareTimestamp = 0;
+    ULONG configPriorityVlanTag = 3;
+    ULONG configVlanId = 0;
+    ULONG configReceiveBuffers = 0;
+    ULONG configTransmitBuffers = 0;
+    ULONG configFlowControl = FlowControlTxPause | FlowControlRxPause;
+    ULONG configTxThreshold = 0;
+    ULONG configEee = 0;
+    ULONG configLpiEntryTimer = 1000;
+    L3L4Filter configL3L4Filters[L3L4FiltersMax] = {};
 
     // Read configuration
 
@@ -746,8 +2427,127 @@ DevicePrepareHardware(
             memcpy(context->currentMacAddress, configAddress.Address, sizeof(context->currentMacAddress));
             configHasMacAddress = true;
         }
+
+        DECLARE_CONST_UNICODE_STRING(rxQueuesName, L"RxQueues");
+        ULONG rxQueues;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &rxQueuesName, &rxQueues);
+        if (NT_SUCCESS(status) && rxQueues != 0)
+        {
+            configRxQueues = rxQueues;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(jumboPacketName, L"*JumboPacket");
+        ULONG jumboPacket;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &jumboPacketName, &jumboPacket);
+        if (NT_SUCCESS(status))
+        {
+            configJumboPacket = jumboPacket;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(rxInterruptModerationName, L"RxInterruptModeration");
+        ULONG rxInterruptModeration;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &rxInterruptModerationName, &rxInterruptModeration);
+        if (NT_SUCCESS(status) && rxInterruptModeration < RxInterruptModerationMax)
+        {
+            configRxInterruptModeration = rxInterruptModeration;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(rxCopyBreakName, L"RxCopyBreak");
+        ULONG rxCopyBreak;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &rxCopyBreakName, &rxCopyBreak);
+        if (NT_SUCCESS(status))
+        {
+            configRxCopyBreak = rxCopyBreak;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(headerDataSplitName, L"*HeaderDataSplit");
+        ULONG headerDataSplit;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &headerDataSplitName, &headerDataSplit);
+        if (NT_SUCCESS(status))
+        {
+            configHeaderDataSplit = headerDataSplit;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(ptpHardwareTimestampName, L"*PtpHardwareTimestamp");
+        ULONG ptpHardwareTimestamp;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &ptpHardwareTimestampName, &ptpHardwareTimestamp);
+        if (NT_SUCCESS(status))
+        {
+            configPtpHardwareTimestamp = ptpHardwareTimestamp;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(priorityVlanTagName, L"*PriorityVLANTag");
+        ULONG priorityVlanTag;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &priorityVlanTagName, &priorityVlanTag);
+        if (NT_SUCCESS(status) && priorityVlanTag <= 3)
+        {
+            configPriorityVlanTag = priorityVlanTag;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(vlanIdName, L"VlanID");
+        ULONG vlanId;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &vlanIdName, &vlanId);
+        if (NT_SUCCESS(status) && vlanId <= VlanIdMax)
+        {
+            configVlanId = vlanId;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(receiveBuffersName, L"*ReceiveBuffers");
+        ULONG receiveBuffers;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &receiveBuffersName, &receiveBuffers);
+        if (NT_SUCCESS(status))
+        {
+            configReceiveBuffers = receiveBuffers;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(transmitBuffersName, L"*TransmitBuffers");
+        ULONG transmitBuffers;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &transmitBuffersName, &transmitBuffers);
+        if (NT_SUCCESS(status))
+        {
+            configTransmitBuffers = transmitBuffers;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(flowControlName, L"*FlowControl");
+        ULONG flowControl;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &flowControlName, &flowControl);
+        if (NT_SUCCESS(status) && flowControl <= (FlowControlTxPause | FlowControlRxPause))
+        {
+            configFlowControl = flowControl;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(txThresholdName, L"TxThreshold");
+        ULONG txThreshold;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &txThresholdName, &txThreshold);
+        if (NT_SUCCESS(status) && txThreshold <= TxThresholdMax)
+        {
+            configTxThreshold = txThreshold;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(eeeName, L"EEE");
+        ULONG eee;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &eeeName, &eee);
+        if (NT_SUCCESS(status))
+        {
+            configEee = eee;
+        }
+
+        DECLARE_CONST_UNICODE_STRING(lpiEntryTimerName, L"LpiEntryTimer");
+        ULONG lpiEntryTimer;
+        status = NetConfigurationQueryUlong(configuration, NET_CONFIGURATION_QUERY_ULONG_NO_FLAGS, &lpiEntryTimerName, &lpiEntryTimer);
+        if (NT_SUCCESS(status))
+        {
+            configLpiEntryTimer = lpiEntryTimer;
+        }
+
+        for (unsigned i = 0; i != L3L4FiltersMax; i += 1)
+        {
+            configL3L4Filters[i] = DeviceL3L4FilterQuery(configuration, i);
+        }
     }
 
+    DeviceRecoveryLoad(device, context);
+
     // Configure resources
 
     {
@@ -801,7 +2601,7 @@ DevicePrepareHardware(
                         TraceLoggingHexInt32(desc->u.Interrupt.Vector, "vector"));
 
                     WDF_INTERRUPT_CONFIG config;
-                    WDF_INTERRUPT_CONFIG_INIT(&config, DeviceInterruptIsr, DeviceInterruptDpc);
+                    WDF_INTERRUPT_CONFIG_INIT(&config, DeviceInterruptIsr, nullptr); // ISR queues a DPC per channel.
                     config.InterruptRaw = descRaw;
                     config.InterruptTranslated = desc;
 
@@ -814,9 +2614,27 @@ DevicePrepareHardware(
                     }
                     break;
                 case 1:
+                {
                     TraceWrite("DevicePrepareHardware-interrupt-pmt", LEVEL_VERBOSE,
-                        TraceLoggingHexInt32(desc->u.Interrupt.Vector, "vector"));
+                        TraceLoggingHexInt32(desc->u.Interrupt.Vector, "vector"),
+                        TraceLoggingHexInt16(desc->Flags, "flags"));
+
+                    // Wake-up packets are reported only through this interrupt. Failure is
+                    // not fatal: wake is just not supported.
+                    WDF_INTERRUPT_CONFIG_INIT(&config, DevicePmtInterruptIsr, nullptr);
+                    config.InterruptRaw = descRaw;
+                    config.InterruptTranslated = desc;
+                    config.CanWakeDevice = 0 != (desc->Flags & CM_RESOURCE_INTERRUPT_WAKE_HINT);
+
+                    auto const pmtStatus = WdfInterruptCreate(device, &config, WDF_NO_OBJECT_ATTRIBUTES, &context->pmtInterrupt);
+                    if (!NT_SUCCESS(pmtStatus))
+                    {
+                        TraceWrite("WdfInterruptCreate-pmt-failed", LEVEL_WARNING,
+                            TraceLoggingNTStatus(pmtStatus));
+                        context->pmtInterrupt = nullptr;
+                    }
                     break;
+                }
                 default:
                     TraceWrite("DevicePrepareHardware-interrupt-unexpected", LEVEL_WARNING,
                         TraceLoggingHexInt32(desc->u.Interrupt.Vector, "vector"));
@@ -908,13 +2726,30 @@ DevicePrepareHardware(
             status = STATUS_DEVICE_CONFIGURATION_ERROR;
             goto Done;
         }
+
+        // Each Rx queue needs its own MTL queue and DMA channel. Counts are encoded as N - 1.
+        unsigned rxQueueCount = ChannelsMax;
+        rxQueueCount = min(rxQueueCount, context->feature2.RxQCnt + 1u);
+        rxQueueCount = min(rxQueueCount, context->feature2.RxChCnt + 1u);
+        rxQueueCount = min(rxQueueCount, configRxQueues);
+        context->rxQueueCount = static_cast<UINT8>(rxQueueCount);
+        TraceWrite("DevicePrepareHardware-queues", LEVEL_INFO,
+            TraceLoggingUInt32(rxQueueCount),
+            TraceLoggingUInt32(configRxQueues));
     }
 
     // Device Config
 
     {
-        context->config.txCoeSel = context->feature0.TxChecksumOffload;
+        // Tx checksum insertion and TSO need the whole packet in the Tx FIFO, so they
+        // are not available with a cut-through Tx threshold.
+        context->config.txThreshold = static_cast<UINT16>(configTxThreshold);
+        context->config.txCoeSel = context->feature0.TxChecksumOffload && configTxThreshold == 0;
         context->config.rxCoeSel = context->feature0.RxChecksumOffload;
+        context->config.tsoEn = context->feature1.TsoEn && configTxThreshold == 0;
+        context->config.flowControl = static_cast<UINT8>(configFlowControl);
+        context->config.priorityVlanTag = context->feature0.SaVlanIns ? static_cast<UINT8>(configPriorityVlanTag) : 0u;
+        context->config.vlanId = static_cast<UINT16>(configVlanId);
         context->config.pblX8 = true;
         context->config.pbl = 8;
         context->config.txPbl = context->config.pbl;
@@ -924,6 +2759,71 @@ DevicePrepareHardware(
         context->config.wr_osr_lmt = 4;
         context->config.rd_osr_lmt = 8;
         context->config.blen = 0x7; // 0x7 = 4, 8, 16
+        context->config.jumboPacket = static_cast<UINT16>(
+            configJumboPacket < JumboPacketMin ? JumboPacketMin
+            : configJumboPacket > JumboPacketMax ? JumboPacketMax
+            : configJumboPacket);
+        context->config.rxInterruptModeration = static_cast<UINT8>(configRxInterruptModeration);
+        context->config.rxCopyBreak = static_cast<UINT16>(min(configRxCopyBreak, RxCopyBreakMax));
+
+        // Split header uses two system-managed fragments per descriptor. It is not used
+        // with copy-break (driver-managed buffers) or jumbo frames.
+        context->config.rxSplitHeader = configHeaderDataSplit != 0 &&
+            context->feature1.SplitHeader &&
+            context->config.rxCopyBreak == 0 &&
+            context->config.jumboPacket == JumboPacketMin;
+
+        // *ReceiveBuffers and *TransmitBuffers count descriptors. They are rounded to the
+        // descriptor ring sizes the queues can allocate, then converted to fragments.
+        context->config.rxBuffers = static_cast<UINT16>(
+            configReceiveBuffers == 0 ? 0u
+            : QueueDescriptorCount(configReceiveBuffers) * (context->config.rxSplitHeader ? 2u : 1u));
+        context->config.txBuffers = static_cast<UINT16>(
+            configTransmitBuffers == 0 ? 0u : QueueDescriptorCount(configTransmitBuffers));
+        context->config.ptpTimestamp = configPtpHardwareTimestamp != 0 && context->feature0.Timestamp;
+        context->config.ptpRefRate = DefaultPtpRefRate;
+        context->config.csrRate = DefaultCsrRate;
+        context->config.eee = configEee != 0 && context->feature0.EnergyEfficient;
+        context->config.lpiEntryTimer = configLpiEntryTimer < 8u ? 8u
+            : min(configLpiEntryTimer, LpiEntryTimerMax) & LpiEntryTimerMax;
+
+        // Filters that the MAC doesn't have or that target a missing Rx queue stay disabled.
+        for (unsigned i = 0; i != L3L4FiltersMax; i += 1)
+        {
+            auto const& filter = configL3L4Filters[i];
+            if (filter.protocol != L3L4FilterProtocolNone &&
+                (i >= context->feature1.L3L4Filters ||
+                 (filter.action != L3L4FilterActionDrop && filter.action - L3L4FilterActionQueue0 >= context->rxQueueCount)))
+            {
+                TraceWrite("DevicePrepareHardware-L3L4Filter-unsupported", LEVEL_WARNING,
+                    TraceLoggingUInt32(i),
+                    TraceLoggingUInt32(context->feature1.L3L4Filters, "L3L4Filters"),
+                    TraceLoggingUInt8(filter.action, "action"));
+                context->config.l3l4Filters[i] = {};
+            }
+            else
+            {
+                context->config.l3l4Filters[i] = filter;
+            }
+        }
+        TraceWrite("DevicePrepareHardware-config", LEVEL_INFO,
+            TraceLoggingUInt32(configJumboPacket),
+            TraceLoggingUInt16(context->config.jumboPacket, "jumboPacket"),
+            TraceLoggingUInt8(context->config.rxInterruptModeration, "rxInterruptModeration"),
+            TraceLoggingUInt16(context->config.rxCopyBreak, "rxCopyBreak"),
+            TraceLoggingUInt16(context->config.rxBuffers, "rxBuffers"),
+            TraceLoggingUInt16(context->config.txBuffers, "txBuffers"),
+            TraceLoggingUInt32(configHeaderDataSplit),
+            TraceLoggingBoolean(context->config.rxSplitHeader, "rxSplitHeader"),
+            TraceLoggingUInt8(context->config.priorityVlanTag, "priorityVlanTag"),
+            TraceLoggingUInt16(context->config.vlanId, "vlanId"),
+            TraceLoggingUInt32(configPtpHardwareTimestamp),
+            TraceLoggingBoolean(context->config.ptpTimestamp, "ptpTimestamp"),
+            TraceLoggingUInt8(context->config.flowControl, "flowControl"),
+            TraceLoggingUInt16(context->config.txThreshold, "txThreshold"),
+            TraceLoggingUInt32(configEee),
+            TraceLoggingBoolean(context->config.eee, "eee"),
+            TraceLoggingUInt32(context->config.lpiEntryTimer, "lpiEntryTimer"));
 
         auto const deviceObject = WdfDeviceWdmGetPhysicalDevice(device);
         PACPI_EVAL_OUTPUT_BUFFER outputBuffer = nullptr;
@@ -986,6 +2886,18 @@ DevicePrepareHardware(
             context->config.mixed_burst = valueI32 != 0;
         }
 
+        status = AcpiDevicePropertiesQueryIntegerValue(properties, "snps,ptp-ref-clk-rate", &valueI32);
+        if (NT_SUCCESS(status) && valueI32 >= 2 * NsPerSecond / 0xFFu && valueI32 <= 2 * NsPerSecond)
+        {
+            context->config.ptpRefRate = valueI32;
+        }
+
+        status = AcpiDevicePropertiesQueryIntegerValue(properties, "snps,csr-clk-rate", &valueI32);
+        if (NT_SUCCESS(status) && valueI32 >= 1'000'000u && valueI32 <= 800'000'000u)
+        {
+            context->config.csrRate = valueI32;
+        }
+
         CHAR valueString[5];
         status = AcpiDevicePropertiesQueryStringValue(properties, "snps,axi-config", sizeof(valueString), &valueLength, valueString);
         if (!NT_SUCCESS(status) || valueLength != 5)
@@ -1080,7 +2992,7 @@ DevicePrepareHardware(
             ? WdfDmaProfileScatterGather
             : WdfDmaProfileScatterGather64;
         WDF_DMA_ENABLER_CONFIG config;
-        WDF_DMA_ENABLER_CONFIG_INIT(&config, profile, 16384); // TODO: Jumbo packets.
+        WDF_DMA_ENABLER_CONFIG_INIT(&config, profile, DmaMaximumLength);
         config.WdmDmaVersionOverride = 3;
 
         switch (context->feature1.AddressWidth)
@@ -1131,18 +3043,31 @@ DevicePrepareHardware(
         NET_ADAPTER_LINK_LAYER_CAPABILITIES_INIT(&linkCaps, maxSpeed, maxSpeed);
         NetAdapterSetLinkLayerCapabilities(context->adapter, &linkCaps);
 
-        NetAdapterSetLinkLayerMtuSize(context->adapter, 1500); // TODO: Jumbo packets.
+        NetAdapterSetLinkLayerMtuSize(context->adapter, context->config.jumboPacket - EthernetHeaderSize);
 
         NET_ADAPTER_DMA_CAPABILITIES dmaCaps;
         NET_ADAPTER_DMA_CAPABILITIES_INIT(&dmaCaps, context->dma);
         dmaCaps.MaximumPhysicalAddress = maxPhysicalAddress;
 
         NET_ADAPTER_TX_CAPABILITIES txCaps;
-        NET_ADAPTER_TX_CAPABILITIES_INIT_FOR_DMA(&txCaps, &dmaCaps, QueuesSupported);
-        txCaps.MaximumNumberOfFragments = QueueDescriptorMinCount - 1;
+        NET_ADAPTER_TX_CAPABILITIES_INIT_FOR_DMA(&txCaps, &dmaCaps, TxQueuesSupported);
+        txCaps.MaximumNumberOfFragments = QueueDescriptorMinCount - 1 - TxExtraDescriptorsMax;
+        txCaps.FragmentRingNumberOfElementsHint = context->config.txBuffers;
+
+        // Jumbo frames are received into multiple RxBufferSize fragments (one per descriptor).
+        // Additional Rx queues are plain multi-queue (no RSS), see DeviceRxSteeringSet.
+        // With copy-break enabled, the Rx queues own their buffers (see rxqueue.cpp).
+        NET_ADAPTER_RX_CAPABILITIES rxCaps;
+        if (context->config.rxCopyBreak != 0)
+        {
+            NET_ADAPTER_RX_CAPABILITIES_INIT_DRIVER_MANAGED(&rxCaps, AdapterReturnRxBuffer, RxBufferSize, context->rxQueueCount);
+        }
+        else
+        {
+            NET_ADAPTER_RX_CAPABILITIES_INIT_SYSTEM_MANAGED_DMA(&rxCaps, &dmaCaps, RxBufferSize, context->rxQueueCount);
+        }
 
-        NET_ADAPTER_RX_CAPABILITIES rxCaps; // TODO: Might use less memory if driver-managed.
-        NET_ADAPTER_RX_CAPABILITIES_INIT_SYSTEM_MANAGED_DMA(&rxCaps, &dmaCaps, RxBufferSize, QueuesSupported); // TODO: Jumbo packets.
+        rxCaps.FragmentRingNumberOfElementsHint = context->config.rxBuffers;
 
         NetAdapterSetDataPathCapabilities(context->adapter, &txCaps, &rxCaps);
 
@@ -1150,8 +3075,8 @@ DevicePrepareHardware(
         NET_ADAPTER_RECEIVE_FILTER_CAPABILITIES rxFilterCaps;
         NET_ADAPTER_RECEIVE_FILTER_CAPABILITIES_INIT(&rxFilterCaps, AdapterSetReceiveFilter);
         rxFilterCaps.MaximumMulticastAddresses =
-            context->feature0.MacAddrCount > 1
-            ? context->feature0.MacAddrCount - 1
+            MulticastHashBits(context) != 0 ? MulticastHashListMax
+            : context->feature0.MacAddrCount > 1 ? context->feature0.MacAddrCount - 1
             : 0;
         rxFilterCaps.SupportedPacketFilters =
             NetPacketFilterFlagDirected |
@@ -1161,6 +3086,48 @@ DevicePrepareHardware(
             NetPacketFilterFlagPromiscuous;
         NetAdapterSetReceiveFilterCapabilities(context->adapter, &rxFilterCaps);
 
+        // Power management offloads and wake sources (see DevicePmtArm).
+        if (context->feature0.ArpOffload)
+        {
+            NET_ADAPTER_POWER_OFFLOAD_ARP_CAPABILITIES arpCaps;
+            NET_ADAPTER_POWER_OFFLOAD_ARP_CAPABILITIES_INIT(&arpCaps);
+            arpCaps.MaximumOffloadCount = 1; // One Mac_Arp_Address.
+            NetAdapterPowerOffloadSetArpCapabilities(context->adapter, &arpCaps);
+        }
+
+        if (context->pmtInterrupt != nullptr)
+        {
+            if (context->feature0.MagicPacket)
+            {
+                NET_ADAPTER_WAKE_MAGIC_PACKET_CAPABILITIES magicCaps;
+                NET_ADAPTER_WAKE_MAGIC_PACKET_CAPABILITIES_INIT(&magicCaps);
+                magicCaps.MagicPacket = true;
+                NetAdapterWakeSetMagicPacketCapabilities(context->adapter, &magicCaps);
+            }
+
+            if (context->feature0.RemoteWake)
+            {
+                NET_ADAPTER_WAKE_BITMAP_CAPABILITIES bitmapCaps;
+                NET_ADAPTER_WAKE_BITMAP_CAPABILITIES_INIT(&bitmapCaps);
+                bitmapCaps.BitmapPattern = true;
+                bitmapCaps.MaximumPatternCount = PmtWakeFiltersMax;
+                bitmapCaps.MaximumPatternSize = PmtWakePatternSizeMax;
+                NetAdapterWakeSetBitmapCapabilities(context->adapter, &bitmapCaps);
+            }
+
+            if (context->feature0.MagicPacket || context->feature0.RemoteWake)
+            {
+                WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS wakeSettings;
+                WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS_INIT(&wakeSettings);
+                auto const wakeStatus = WdfDeviceAssignSxWakeSettings(device, &wakeSettings);
+                if (!NT_SUCCESS(wakeStatus))
+                {
+                    TraceWrite("WdfDeviceAssignSxWakeSettings-failed", LEVEL_WARNING,
+                        TraceLoggingNTStatus(wakeStatus));
+                }
+            }
+        }
+
         if (context->config.txCoeSel)
         {
             NET_ADAPTER_OFFLOAD_TX_CHECKSUM_CAPABILITIES txChecksumCaps;
@@ -1175,6 +3142,31 @@ DevicePrepareHardware(
                 NetAdapterOffloadLayer4FlagTcpWithOptions |
                 NetAdapterOffloadLayer4FlagUdp;
             NetAdapterOffloadSetTxChecksumCapabilities(context->adapter, &txChecksumCaps);
+
+            // TSO needs Tx checksum offload (hardware inserts the segment checksums).
+            if (context->config.tsoEn)
+            {
+                NET_ADAPTER_OFFLOAD_GSO_CAPABILITIES gsoCaps;
+                NET_ADAPTER_OFFLOAD_GSO_CAPABILITIES_INIT(&gsoCaps,
+                    NetAdapterOffloadLayer3FlagIPv4NoOptions |
+                    NetAdapterOffloadLayer3FlagIPv4WithOptions |
+                    NetAdapterOffloadLayer3FlagIPv6NoExtensions,
+                    NetAdapterOffloadLayer4FlagTcpNoOptions |
+                    NetAdapterOffloadLayer4FlagTcpWithOptions,
+                    TxTsoMaximumOffloadSize,
+                    2, // MinimumSegmentCount
+                    AdapterOffloadSetGso);
+                NetAdapterOffloadSetGsoCapabilities(context->adapter, &gsoCaps);
+            }
+        }
+
+        if (context->config.priorityVlanTag != 0)
+        {
+            NET_ADAPTER_OFFLOAD_IEEE8021Q_TAG_CAPABILITIES ieee8021qCaps;
+            NET_ADAPTER_OFFLOAD_IEEE8021Q_TAG_CAPABILITIES_INIT(&ieee8021qCaps,
+                ((context->config.priorityVlanTag & 1) ? NetAdapterOffloadIeee8021PriorityTaggingFlag : NET_ADAPTER_OFFLOAD_IEEE8021Q_TAG_FLAGS()) |
+                ((context->config.priorityVlanTag & 2) ? NetAdapterOffloadIeee8021VlanTaggingFlag : NET_ADAPTER_OFFLOAD_IEEE8021Q_TAG_FLAGS()));
+            NetAdapterOffloadSetIeee8021qTagCapabilities(context->adapter, &ieee8021qCaps);
         }
 
         NET_ADAPTER_OFFLOAD_RX_CHECKSUM_CAPABILITIES rxChecksumCaps;
@@ -1208,14 +3200,25 @@ DevicePrepareHardware(
         busMode.FixedBurst = context->config.fixed_burst;
         Write32(&regs->Dma_SysBus_Mode, busMode);
 
-        Write32(&regs->Mac_1us_Tic_Counter, DefaultCsrRate / 1'000'000u - 1);
+        Write32(&regs->Mac_1us_Tic_Counter, context->config.csrRate / 1'000'000u - 1);
+
+        // EEE needs the PHY's EEE advertisement and link partner ability (MDIO).
+        context->phyAddress = context->config.eee ? DevicePhyFind(context) : PhyAddressNone;
+        if (context->phyAddress == PhyAddressNone)
+        {
+            context->config.eee = false;
+        }
 
         static_assert(QueueDescriptorSize % BusBytes == 0,
             "QueueDescriptorSize must be a multiple of bus width.");
         ChannelDmaControl_t dmaControl = {};
         dmaControl.DescriptorSkipLength = (QueueDescriptorSize - 16) / BusBytes;
         dmaControl.PblX8 = context->config.pblX8;
-        Write32(&regs->Dma_Ch[0].Control, dmaControl);
+        dmaControl.SplitHeader = context->config.rxSplitHeader;
+        for (unsigned channel = 0; channel != context->rxQueueCount; channel += 1)
+        {
+            Write32(&regs->Dma_Ch[channel].Control, dmaControl);
+        }
 
         // Disable MMC counter interrupts.
         Write32(&regs->Mmc_Rx_Interrupt_Mask, 0xFFFFFFFF);  // RXWDOGP,RXFOVP,RXPAUSP,RXLENERP,RXOSIZEGP,RXCRCERP,RXMCGP,RXGOCT,RXGBOCT,RXGBPKT
@@ -1268,21 +3271,67 @@ _IRQL_requires_max_(PASSIVE_LEVEL)
 void
 DeviceSetNotificationRxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     _In_opt_ NETPACKETQUEUE rxQueue)
 {
     // PASSIVE_LEVEL, nonpaged (resume path, raises IRQL)
+    NT_ASSERT(channel < ChannelsMax);
 
     WdfSpinLockAcquire(context->queueLock); // PASSIVE_LEVEL --> DISPATCH_LEVEL
-    context->rxQueue = rxQueue;
+    context->channels[channel].rxQueue = rxQueue;
     WdfSpinLockRelease(context->queueLock); // DISPATCH_LEVEL --> PASSIVE_LEVEL
 
     if (rxQueue)
     {
-        DeviceInterruptEnable(context, InterruptsRx);
+        DeviceInterruptEnable(context, channel, InterruptsRx);
     }
     else
     {
-        DeviceInterruptDisable(context, InterruptsRx);
+        DeviceInterruptDisable(context, channel, InterruptsRx);
+    }
+}
+
+_IRQL_requires_max_(PASSIVE_LEVEL)
+void
+DeviceSetRxQueueStarted(
+    _Inout_ DeviceContext* context,
+    UINT8 channel,
+    bool started)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    NT_ASSERT(channel < context->rxQueueCount);
+
+    // NetAdapterCx starts and stops the queues one at a time, so no lock is needed.
+    auto const oldActive = DeviceRxQueuesActive(context);
+    if (started)
+    {
+        context->rxQueuesStarted |= 1u << channel;
+    }
+    else
+    {
+        context->rxQueuesStarted &= ~(1u << channel);
+    }
+
+    auto const newActive = DeviceRxQueuesActive(context);
+    if (newActive == oldActive)
+    {
+        return;
+    }
+
+    // Retarget everything that selects an Rx queue (see DeviceRxSteeringSet).
+    DeviceRxSteeringSet(context);
+
+    for (unsigned i = 1; i < context->feature0.MacAddrCount; i += 1)
+    {
+        auto high = Read32(&context->regs->Mac_Address[i].High);
+        high.DmaChannelSelect = static_cast<BYTE>(newActive - 1u);
+        Write32(&context->regs->Mac_Address[i].High, high);
+        Write32(&context->regs->Mac_Address[i].Low, Read32(&context->regs->Mac_Address[i].Low)); // Low write latches the pair.
+    }
+
+    for (unsigned i = 0; i != min(context->feature1.L3L4Filters, L3L4FiltersMax); i += 1)
+    {
+        DeviceL3L4FilterSet(context, i, context->config.l3l4Filters[i]);
     }
 }
 
@@ -1290,47 +3339,105 @@ _IRQL_requires_max_(PASSIVE_LEVEL)
 void
 DeviceSetNotificationTxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     _In_opt_ NETPACKETQUEUE txQueue)
 {
     // PASSIVE_LEVEL, nonpaged (resume path, raises IRQL)
+    NT_ASSERT(channel < ChannelsMax);
 
     WdfSpinLockAcquire(context->queueLock); // PASSIVE_LEVEL --> DISPATCH_LEVEL
-    context->txQueue = txQueue;
+    context->channels[channel].txQueue = txQueue;
     WdfSpinLockRelease(context->queueLock); // DISPATCH_LEVEL --> PASSIVE_LEVEL
 
     if (txQueue)
     {
-        DeviceInterruptEnable(context, InterruptsTx);
+        DeviceInterruptEnable(context, channel, InterruptsTx);
     }
     else
     {
-        DeviceInterruptDisable(context, InterruptsTx);
+        DeviceInterruptDisable(context, channel, InterruptsTx);
     }
 
 }
 
+_IRQL_requires_max_(DISPATCH_LEVEL)
+void
+DeviceStartTxCompletionTimer(
+    _Inout_ DeviceContext* context,
+    UINT8 channel)
+{
+    // DISPATCH_LEVEL
+    NT_ASSERT(channel < ChannelsMax);
+    WdfTimerStart(context->channels[channel].txCompletionTimer, WDF_REL_TIMEOUT_IN_US(TxCompletionTimeoutUs));
+}
+
 _IRQL_requires_max_(DISPATCH_LEVEL)
 void
 DeviceAddStatisticsRxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     UINT32 ownDescriptors,
-    UINT32 doneFragments)
+    UINT32 doneFragments,
+    UINT32 donePackets,
+    UINT32 descUsed,
+    UINT32 descCount,
+    _In_reads_(L3L4FiltersMax) UINT32 const* filterMatches)
 {
     // DISPATCH_LEVEL
-    context->rxOwnDescriptors += ownDescriptors;
-    context->rxDoneFragments += doneFragments;
+    NT_ASSERT(channel < ChannelsMax);
+    auto const channelContext = &context->channels[channel];
+    channelContext->rxOwnDescriptors += ownDescriptors;
+    channelContext->rxDoneFragments += doneFragments;
+    for (unsigned i = 0; i != L3L4FiltersMax; i += 1)
+    {
+        channelContext->rxL3L4FilterMatches[i] += filterMatches[i];
+    }
+    channelContext->rxPacketsHistogram[HistogramLog2Bucket(donePackets)] += 1;
+    channelContext->rxRingHistogram[HistogramRingBucket(descUsed, descCount)] += 1;
 }
 
 _IRQL_requires_max_(DISPATCH_LEVEL)
 void
 DeviceAddStatisticsTxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     UINT32 ownDescriptors,
-    UINT32 doneFragments)
+    UINT32 doneFragments,
+    UINT32 donePackets,
+    UINT32 descUsed,
+    UINT32 descCount)
 {
     // DISPATCH_LEVEL
-    context->txOwnDescriptors += ownDescriptors;
-    context->txDoneFragments += doneFragments;
+    NT_ASSERT(channel < ChannelsMax);
+    auto const channelContext = &context->channels[channel];
+    channelContext->txOwnDescriptors += ownDescriptors;
+    channelContext->txDoneFragments += doneFragments;
+    channelContext->txDonePackets += donePackets;
+    channelContext->txPacketsHistogram[HistogramLog2Bucket(donePackets)] += 1;
+    channelContext->txRingHistogram[HistogramRingBucket(descUsed, descCount)] += 1;
+}
+
+_IRQL_requires_max_(DISPATCH_LEVEL)
+void
+DeviceSetPacketTimestamp(
+    _Inout_ DeviceContext* context,
+    bool transmit,
+    UINT8 messageType,
+    UINT16 sequenceId,
+    UINT32 seconds,
+    UINT32 nanoseconds)
+{
+    // DISPATCH_LEVEL
+    auto const timeNs = seconds * UINT64(NsPerSecond) + nanoseconds;
+
+    WdfSpinLockAcquire(context->ptpLock);
+    auto& next = context->ptpTimestampNext[transmit];
+    auto& entry = context->ptpTimestamps[transmit][next];
+    entry.timeNs = timeNs;
+    entry.id.messageType = messageType;
+    entry.id.sequenceId = sequenceId;
+    next = static_cast<UINT8>((next + 1u) % PtpTimestampQueueSize);
+    WdfSpinLockRelease(context->ptpLock);
 }
 
 __declspec(code_seg("PAGE"))
@@ -1426,6 +3533,14 @@ DeviceAdd(
             goto Done;
         }
 
+        status = WdfSpinLockCreate(&attributes, &context->ptpLock);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfSpinLockCreate-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+
         WDF_WORKITEM_CONFIG workItemConfig;
         WDF_WORKITEM_CONFIG_INIT(&workItemConfig, DeviceLinkStateWorkItem);
         status = WdfWorkItemCreate(&workItemConfig, &attributes, &context->updateLinkStateWorkItem);
@@ -1436,9 +3551,87 @@ DeviceAdd(
             goto Done;
         }
 
+        WDF_WORKITEM_CONFIG_INIT(&workItemConfig, DeviceRecoveryWorkItem);
+        status = WdfWorkItemCreate(&workItemConfig, &attributes, &context->recoveryWorkItem);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfWorkItemCreate-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+
+        for (unsigned channel = 0; channel != ChannelsMax; channel += 1)
+        {
+            WDF_OBJECT_ATTRIBUTES dpcAttributes;
+            WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&dpcAttributes, ChannelDpcContext);
+            dpcAttributes.ParentObject = device;
+
+            WDF_DPC_CONFIG dpcConfig;
+            WDF_DPC_CONFIG_INIT(&dpcConfig, DeviceChannelDpc);
+            dpcConfig.AutomaticSerialization = false;
+            status = WdfDpcCreate(&dpcConfig, &dpcAttributes, &context->channels[channel].dpc);
+            if (!NT_SUCCESS(status))
+            {
+                TraceWrite("WdfDpcCreate-failed", LEVEL_ERROR,
+                    TraceLoggingNTStatus(status));
+                goto Done;
+            }
+
+            ChannelDpcGetContext(context->channels[channel].dpc)->channel = static_cast<UINT8>(channel);
+
+            WDF_OBJECT_ATTRIBUTES timerAttributes;
+            WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&timerAttributes, ChannelDpcContext);
+            timerAttributes.ParentObject = device;
+
+            WDF_TIMER_CONFIG timerConfig;
+            WDF_TIMER_CONFIG_INIT(&timerConfig, DeviceTxCompletionTimer);
+            timerConfig.AutomaticSerialization = false;
+            timerConfig.UseHighResolutionTimer = WdfTrue;
+            status = WdfTimerCreate(&timerConfig, &timerAttributes, &context->channels[channel].txCompletionTimer);
+            if (!NT_SUCCESS(status))
+            {
+                TraceWrite("WdfTimerCreate-failed", LEVEL_ERROR,
+                    TraceLoggingNTStatus(status));
+                goto Done;
+            }
+
+            ChannelDpcGetContext(context->channels[channel].txCompletionTimer)->channel = static_cast<UINT8>(channel);
+        }
+
         context->devicePdo = WdfDeviceWdmGetPhysicalDevice(device);
     }
 
+    // Expose the PTP clock to other drivers. The functions fail unless the clock is running.
+
+    {
+        auto const context = DeviceGetContext(device);
+
+        DWCEQOS_PTP_INTERFACE_STANDARD ptpInterface = {};
+        ptpInterface.InterfaceHeader.Size = sizeof(ptpInterface);
+        ptpInterface.InterfaceHeader.Version = 1;
+        ptpInterface.InterfaceHeader.Context = context;
+        ptpInterface.InterfaceHeader.InterfaceReference = WdfDeviceInterfaceReferenceNoOp;
+        ptpInterface.InterfaceHeader.InterfaceDereference = WdfDeviceInterfaceDereferenceNoOp;
+        ptpInterface.GetTime = PtpGetTime;
+        ptpInterface.SetTime = PtpSetTime;
+        ptpInterface.AdjustTime = PtpAdjustTime;
+        ptpInterface.AdjustFrequency = PtpAdjustFrequency;
+        ptpInterface.GetPacketTimestamp = PtpGetPacketTimestamp;
+
+        WDF_QUERY_INTERFACE_CONFIG qiConfig;
+        WDF_QUERY_INTERFACE_CONFIG_INIT(&qiConfig,
+            reinterpret_cast<INTERFACE*>(&ptpInterface),
+            &GUID_DWCEQOS_PTP_INTERFACE_STANDARD,
+            nullptr);
+        status = WdfDeviceAddQueryInterface(device, &qiConfig);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfDeviceAddQueryInterface-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+    }
+
     // Create adapter.
 
     {
@@ -1522,6 +3715,10 @@ PerfDataInit(
     READ_COUNTER(Mmc_Rx_Packet_Smd_Err_Cntr);
     READ_COUNTER(Mmc_Rx_Packet_Assembly_OK_Cntr);
     READ_COUNTER(Mmc_Rx_Fpe_Fragment_Cntr);
+    READ_COUNTER(Tx_Lpi_Usec_Cntr);
+    READ_COUNTER(Tx_Lpi_Tran_Cntr);
+    READ_COUNTER(Rx_Lpi_Usec_Cntr);
+    READ_COUNTER(Rx_Lpi_Tran_Cntr);
 #undef READ_COUNTER
 }
 
@@ -1538,14 +3735,28 @@ PerfDataInit(
     data->IsrHandled = context->isrHandled;
     data->IsrIgnored = context->isrIgnored;
     data->DpcLinkState = context->dpcLinkState;
-    data->DpcRx = context->dpcRx;
-    data->DpcTx = context->dpcTx;
-    data->DpcAbnormalStatus = context->dpcAbnormalStatus;
-    data->DpcFatalBusError = context->dpcFatalBusError;
-    data->RxOwnDescriptors = context->rxOwnDescriptors;
-    data->RxDoneFragments = context->rxDoneFragments;
-    data->TxOwnDescriptors = context->txOwnDescriptors;
-    data->TxDoneFragments = context->txDoneFragments;
+    data->Recoveries = context->recoveries;
+    data->RecoveryMilliseconds = context->recoveryMilliseconds;
+    data->RxFifoOverflowRate = READ_REGISTER_NOFENCE_ULONG(&context->regs->Rx_Fifo_Overflow_Packets);
+    data->TxPauseRate = READ_REGISTER_NOFENCE_ULONG(&context->regs->Tx_Pause_Packets);
+
+    // Per-channel counters are reported as totals.
+    for (auto const& channelContext : context->channels)
+    {
+        data->DpcRx += channelContext.dpcRx;
+        data->DpcTx += channelContext.dpcTx;
+        data->DpcAbnormalStatus += channelContext.dpcAbnormalStatus;
+        data->DpcFatalBusError += channelContext.dpcFatalBusError;
+        data->RxOwnDescriptors += channelContext.rxOwnDescriptors;
+        data->RxDoneFragments += channelContext.rxDoneFragments;
+        data->TxOwnDescriptors += channelContext.txOwnDescriptors;
+        data->TxDoneFragments += channelContext.txDoneFragments;
+        data->TxDonePackets += channelContext.txDonePackets;
+        data->TxInterruptsPerPacket += channelContext.dpcTx;
+        data->TxCompletionTimer += channelContext.timerTx;
+        data->L3L4Filter0Hits += channelContext.rxL3L4FilterMatches[0];
+        data->L3L4Filter1Hits += channelContext.rxL3L4FilterMatches[1];
+    }
 }
 
 // Implements the performance counter callback for a given DataType.
@@ -1602,6 +3813,83 @@ PerfCallback(
     return STATUS_SUCCESS;
 }
 
+// Implements the performance counter callback for PERF_HISTOGRAM_DATA.
+// Same as PerfCallback, but with one instance per channel, named "device-channel".
+_IRQL_requires_max_(APC_LEVEL)
+__declspec(code_seg("PAGE"))
+static NTSTATUS NTAPI
+PerfHistogramCallback(
+    _In_ PCW_CALLBACK_TYPE type,
+    _In_ PCW_CALLBACK_INFORMATION* info,
+    _In_opt_ void* callbackContext)
+{
+    PAGED_CODE();
+    UNREFERENCED_PARAMETER(callbackContext);
+
+    if ((type == PcwCallbackEnumerateInstances || type == PcwCallbackCollectData) &&
+        g_devices != nullptr)
+    {
+        auto const buffer = type == PcwCallbackCollectData
+            ? info->CollectData.Buffer
+            : info->EnumerateInstances.Buffer;
+
+        PERF_HISTOGRAM_DATA data = {};
+        wchar_t nameBuffer[12];
+        UNICODE_STRING nameString = {};
+        nameString.Buffer = nameBuffer;
+        nameString.Length = 0;
+        nameString.MaximumLength = sizeof(nameBuffer);
+
+        WdfWaitLockAcquire(g_devicesLock, nullptr);
+
+        auto const count = WdfCollectionGetCount(g_devices);
+        for (ULONG i = 0; i != count; i += 1)
+        {
+            auto const device = static_cast<WDFDEVICE>(WdfCollectionGetItem(g_devices, i));
+            auto const context = DeviceGetContext(device);
+
+            for (UINT8 channel = 0; channel != context->rxQueueCount; channel += 1)
+            {
+                auto const& channelContext = context->channels[channel];
+
+                if (type == PcwCallbackCollectData)
+                {
+#define COPY_HISTOGRAM(name, source) \
+                    data.name##0 = channelContext.source[0]; \
+                    data.name##1 = channelContext.source[1]; \
+                    data.name##2 = channelContext.source[2]; \
+                    data.name##3 = channelContext.source[3]; \
+                    data.name##4 = channelContext.source[4]; \
+                    data.name##5 = channelContext.source[5]; \
+                    data.name##6 = channelContext.source[6]; \
+                    data.name##7 = channelContext.source[7]
+                    static_assert(PerfHistogramBuckets == 8);
+                    COPY_HISTOGRAM(RxPacketsPerAdvance, rxPacketsHistogram);
+                    COPY_HISTOGRAM(RxRingUsed, rxRingHistogram);
+                    COPY_HISTOGRAM(TxPacketsPerAdvance, txPacketsHistogram);
+                    COPY_HISTOGRAM(TxRingUsed, txRingHistogram);
+                    COPY_HISTOGRAM(IsrToDpcMicroseconds, isrToDpcHistogram);
+#undef COPY_HISTOGRAM
+                }
+
+                RtlIntegerToUnicodeString(context->perfCounterDeviceId, 16, &nameString);
+                nameString.Buffer[nameString.Length / sizeof(wchar_t)] = L'-';
+                nameString.Buffer[nameString.Length / sizeof(wchar_t) + 1] = static_cast<wchar_t>(L'0' + channel);
+                nameString.Length += 2 * sizeof(wchar_t);
+
+                // Inline the ctrpp-generated AddXXX function:
+                PCW_DATA pcwData = { &data, sizeof(data) };
+                ULONG const instanceId = (context->perfCounterDeviceId << 4) | channel;
+                (void)PcwAddInstance(buffer, &nameString, instanceId, 1, &pcwData); // Best-effort.
+            }
+        }
+
+        WdfWaitLockRelease(g_devicesLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
 _IRQL_requires_max_(PASSIVE_LEVEL)
 __declspec(code_seg("INIT"))
 void
@@ -1645,6 +3933,13 @@ DevicePerfRegister(_In_ WDFDRIVER driver)
             TraceLoggingNTStatus(status));
     }
 
+    status = RegisterPERF_HISTOGRAM_COUNTERSET(PerfHistogramCallback, nullptr);
+    if (!NT_SUCCESS(status))
+    {
+        TraceWrite("RegisterPERF_HISTOGRAM_COUNTERSET", LEVEL_WARNING,
+            TraceLoggingNTStatus(status));
+    }
+
     status = STATUS_SUCCESS;
 
 Done:
@@ -1659,6 +3954,7 @@ DevicePerfUnregister()
 {
     PAGED_CODE();
 
+    UnregisterPERF_HISTOGRAM_COUNTERSET();
     UnregisterPERF_DEBUG_COUNTERSET();
     UnregisterPERF_MAC_COUNTERSET();
 
@@ -3,13 +3,48 @@ Device behavior. Includes adapter and interrupt since they are 1:1 with the devi
 */
 #pragma once
 
-struct DeviceContext; // TODO: if we do multi-queue, make a DeviceQueueContext struct instead.
+struct DeviceContext;
+
+UINT8 constexpr L3L4FiltersMax = 2; // Size of the Mac_L3_L4 register array.
+
+enum L3L4FilterProtocol : UINT8
+{
+    L3L4FilterProtocolNone = 0, // Filter disabled.
+    L3L4FilterProtocolTcp = 1,
+    L3L4FilterProtocolUdp = 2,
+};
+
+enum L3L4FilterAction : UINT8
+{
+    L3L4FilterActionDrop = 0,
+    L3L4FilterActionQueue0 = 1, // Rx queue N = L3L4FilterActionQueue0 + N.
+};
+
+// Rx filter on TCP/UDP destination port and (optionally) IPv4 destination address.
+struct L3L4Filter
+{
+    L3L4FilterProtocol protocol;
+    L3L4FilterAction action;
+    UINT8 addressPrefix;    // 0 = any address. Ignored for L3L4FilterActionDrop.
+    UINT16 port;            // Destination port, 0 = filter disabled.
+    UINT32 address;         // IPv4 destination address, first octet in the high byte.
+};
+
+// DeviceConfig::flowControl bits, same as the *FlowControl keyword.
+enum FlowControlFlags : UINT8
+{
+    FlowControlTxPause = 1, // Send pause frames when the Rx FIFO fills.
+    FlowControlRxPause = 2, // Stop transmitting when a pause frame is received.
+};
 
 // Information about the device provided to the queues.
 struct DeviceConfig
 {
     bool txCoeSel;      // MAC_HW_Feature0\TXCOESEL (hardware support for tx checksum offload).
     bool rxCoeSel;      // MAC_HW_Feature0\RXCOESEL (hardware support for rx checksum offload).
+    bool tsoEn;         // MAC_HW_Feature1\TSOEN (hardware support for tcp segmentation offload).
+    UINT8 priorityVlanTag; // Ndi\params\*PriorityVLANTag (default = 3) if MAC_HW_Feature0\SAVLANINS, else 0.
+    UINT16 vlanId;      // Ndi\params\VlanID (default = 0): Tx tag if the stack doesn't provide one.
     bool pblX8;         // _DSD\snps,pblx8 (default = 1).
     UINT8 pbl;          // _DSD\snps,pbl (default = 8; effect depends on pblX8).
     UINT8 txPbl;        // _DSD\snps,txpbl (default = pbl; effect depends on pblX8).
@@ -19,6 +54,20 @@ struct DeviceConfig
     UINT8 wr_osr_lmt;   // AXIC\snps,wr_osr_lmt (default = 4).
     UINT8 rd_osr_lmt;   // AXIC\snps,rd_osr_lmt (default = 8).
     UINT8 blen : 7;     // AXIC\snps,blen bitmask of 7 booleans 4..256 (default = 4, 8, 16).
+    UINT16 jumboPacket; // Ndi\params\*JumboPacket (default = 1514): max frame size, excluding CRC.
+    UINT8 rxInterruptModeration; // Ndi\params\RxInterruptModeration (default = 1 = balanced).
+    UINT16 rxCopyBreak; // Ndi\params\RxCopyBreak (default = 0): 0 = system-managed Rx buffers.
+    UINT16 rxBuffers;   // Ndi\params\*ReceiveBuffers (default = 0 = NetAdapterCx default): Rx fragment ring size hint, 2 per descriptor if rxSplitHeader.
+    UINT16 txBuffers;   // Ndi\params\*TransmitBuffers (default = 0 = NetAdapterCx default): Tx fragment ring size hint.
+    bool rxSplitHeader; // Ndi\params\*HeaderDataSplit (default = 0), if SPHEN and not copy-break or jumbo.
+    bool ptpTimestamp;  // Ndi\params\*PtpHardwareTimestamp (default = 0), if MAC_HW_Feature0\TSSEL.
+    UINT32 ptpRefRate;  // _DSD\snps,ptp-ref-clk-rate (default = 50000000): clk_ptp_ref_i in Hz.
+    UINT32 csrRate;     // _DSD\snps,csr-clk-rate (default = 125000000): CSR clock in Hz (MDC divider, 1us tick).
+    L3L4Filter l3l4Filters[L3L4FiltersMax]; // Ndi\params\L3L4FilterN* (default = disabled), if N < MAC_HW_Feature1\L3L4FNUM.
+    UINT8 flowControl;  // Ndi\params\*FlowControl (default = 3): FlowControlTxPause | FlowControlRxPause.
+    UINT16 txThreshold; // Ndi\params\TxThreshold (default = 0 = store-and-forward): Tx cut-through threshold in bytes.
+    bool eee;           // Ndi\params\EEE (default = 0), if MAC_HW_Feature0\EEESEL and a PHY answers on MDIO.
+    UINT32 lpiEntryTimer; // Ndi\params\LpiEntryTimer (default = 1000): microseconds of Tx idle before LPI.
 };
 
 // Referenced in driver.cpp DriverEntry.
@@ -44,27 +93,74 @@ _IRQL_requires_max_(PASSIVE_LEVEL)
 void
 DeviceSetNotificationRxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     _In_opt_ NETPACKETQUEUE rxQueue);
 
+// Called by rxqueue.cpp RxQueueStart and RxQueueStop. Rx steering (multicast/broadcast
+// queue, multicast address DMA channel, L3/L4 queue filters) only targets queues
+// 0..N-1 when all of them are started; otherwise it falls back to queue 0.
+_IRQL_requires_max_(PASSIVE_LEVEL)
+void
+DeviceSetRxQueueStarted(
+    _Inout_ DeviceContext* context,
+    UINT8 channel,
+    bool started);
+
 // Called by txqueue.cpp TxQueueSetNotificationEnabled.
 _IRQL_requires_max_(PASSIVE_LEVEL)
 void
 DeviceSetNotificationTxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     _In_opt_ NETPACKETQUEUE txQueue);
 
+// Called by txqueue.cpp TxQueueSetNotificationEnabled when some queued packets
+// will not raise a Tx interrupt. Simulates a Tx interrupt after a short delay.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+void
+DeviceStartTxCompletionTimer(
+    _Inout_ DeviceContext* context,
+    UINT8 channel);
+
 // Called by rxqueue.cpp RxQueueAdvance.
+// descUsed = received descriptors waiting to be indicated when the call started.
+// filterMatches = received packets that matched each L3/L4 filter. For a drop filter
+// these are the packets it dropped.
 _IRQL_requires_max_(DISPATCH_LEVEL)
 void
 DeviceAddStatisticsRxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     UINT32 ownDescriptors,
-    UINT32 doneFragments);
+    UINT32 doneFragments,
+    UINT32 donePackets,
+    UINT32 descUsed,
+    UINT32 descCount,
+    _In_reads_(L3L4FiltersMax) UINT32 const* filterMatches);
 
 // Called by txqueue.cpp TxQueueAdvance.
+// descUsed = descriptors owned by the DMA engine or not yet completed when the call started.
 _IRQL_requires_max_(DISPATCH_LEVEL)
 void
 DeviceAddStatisticsTxQueue(
     _Inout_ DeviceContext* context,
+    UINT8 channel,
     UINT32 ownDescriptors,
-    UINT32 doneFragments);
+    UINT32 doneFragments,
+    UINT32 donePackets,
+    UINT32 descUsed,
+    UINT32 descCount);
+
+// Called by rxqueue.cpp RxQueueAdvance and txqueue.cpp TxQueueAdvance when
+// DeviceConfig::ptpTimestamp is set and a descriptor reports the timestamp of a PTP
+// event message. messageType/sequenceId identify the message (see QueuePtpEventMessage).
+// seconds/nanoseconds are in the format of the descriptor's timestamp fields.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+void
+DeviceSetPacketTimestamp(
+    _Inout_ DeviceContext* context,
+    bool transmit,
+    UINT8 messageType,
+    UINT16 sequenceId,
+    UINT32 seconds,
+    UINT32 nanoseconds);
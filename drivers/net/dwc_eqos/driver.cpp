@@ -5,12 +5,10 @@
 /*
 Possible areas for improvement:
 - Run against network test suites and fix any issues.
-- Jumbo frames.
 - Configuration in registry (e.g. flow control, speed, duplex).
-- Tx segmentation offload.
 - Wake-on-LAN.
 - ARP offload.
-- Multi-queue support?
+- Multi-queue: hardware has no RSS hash, so Rx queues are split by traffic class.
 */
 
 TRACELOGGING_DEFINE_PROVIDER(
@@ -32,6 +32,70 @@ struct PERF_DEBUG_DATA
     UINT32 RxDoneFragments;
     UINT32 TxOwnDescriptors;
     UINT32 TxDoneFragments;
+    UINT32 TxInterruptsPerPacket; // perf_raw_fraction: DpcTx / TxDonePackets (shown as a percentage).
+    UINT32 TxDonePackets;
+    UINT32 TxCompletionTimer;
+    UINT32 Recoveries; // Fatal error recoveries (persisted across restarts).
+    UINT32 RecoveryMilliseconds; // Duration of the most recent recovery.
+    UINT32 L3L4Filter0Hits; // Received packets that matched L3/L4 filter 0 (dropped, for a drop filter).
+    UINT32 L3L4Filter1Hits; // Received packets that matched L3/L4 filter 1 (dropped, for a drop filter).
+    UINT32 RxFifoOverflowRate; // perf_counter_counter: Rx_Fifo_Overflow_Packets per second.
+    UINT32 TxPauseRate; // perf_counter_counter: Tx_Pause_Packets per second.
+};
+
+/*
+Histograms, one instance per DMA channel (named "device-channel"). Each counter is a
+bucket and counts events. Log2 buckets are 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+.
+Ring buckets are eighths of the descriptor ring: bucket N = [N/8, (N+1)/8).
+*/
+UINT32 constexpr PerfHistogramBuckets = 8;
+struct PERF_HISTOGRAM_DATA
+{
+    // RxQueueAdvance calls by number of packets indicated (log2 buckets).
+    UINT32 RxPacketsPerAdvance0;
+    UINT32 RxPacketsPerAdvance1;
+    UINT32 RxPacketsPerAdvance2;
+    UINT32 RxPacketsPerAdvance3;
+    UINT32 RxPacketsPerAdvance4;
+    UINT32 RxPacketsPerAdvance5;
+    UINT32 RxPacketsPerAdvance6;
+    UINT32 RxPacketsPerAdvance7;
+    // RxQueueAdvance calls by number of received descriptors waiting (ring buckets).
+    UINT32 RxRingUsed0;
+    UINT32 RxRingUsed1;
+    UINT32 RxRingUsed2;
+    UINT32 RxRingUsed3;
+    UINT32 RxRingUsed4;
+    UINT32 RxRingUsed5;
+    UINT32 RxRingUsed6;
+    UINT32 RxRingUsed7;
+    // TxQueueAdvance calls by number of packets completed (log2 buckets).
+    UINT32 TxPacketsPerAdvance0;
+    UINT32 TxPacketsPerAdvance1;
+    UINT32 TxPacketsPerAdvance2;
+    UINT32 TxPacketsPerAdvance3;
+    UINT32 TxPacketsPerAdvance4;
+    UINT32 TxPacketsPerAdvance5;
+    UINT32 TxPacketsPerAdvance6;
+    UINT32 TxPacketsPerAdvance7;
+    // TxQueueAdvance calls by number of descriptors in flight (ring buckets).
+    UINT32 TxRingUsed0;
+    UINT32 TxRingUsed1;
+    UINT32 TxRingUsed2;
+    UINT32 TxRingUsed3;
+    UINT32 TxRingUsed4;
+    UINT32 TxRingUsed5;
+    UINT32 TxRingUsed6;
+    UINT32 TxRingUsed7;
+    // Channel DPCs by microseconds since the ISR queued the DPC (log2 buckets).
+    UINT32 IsrToDpcMicroseconds0;
+    UINT32 IsrToDpcMicroseconds1;
+    UINT32 IsrToDpcMicroseconds2;
+    UINT32 IsrToDpcMicroseconds3;
+    UINT32 IsrToDpcMicroseconds4;
+    UINT32 IsrToDpcMicroseconds5;
+    UINT32 IsrToDpcMicroseconds6;
+    UINT32 IsrToDpcMicroseconds7;
 };
 
 // Each value corresponds directly to a register in the device.
@@ -72,4 +136,8 @@ struct PERF_MAC_DATA
     UINT32 Mmc_Rx_Packet_Smd_Err_Cntr;
     UINT32 Mmc_Rx_Packet_Assembly_OK_Cntr;
     UINT32 Mmc_Rx_Fpe_Fragment_Cntr;
+    UINT32 Tx_Lpi_Usec_Cntr;
+    UINT32 Tx_Lpi_Tran_Cntr;
+    UINT32 Rx_Lpi_Usec_Cntr;
+    UINT32 Rx_Lpi_Tran_Cntr;
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ntddk.h>
+#include <ip2string.h>
 
 #pragma warning(push)
 #pragma warning(disable: 4471) // forward declaration of an unscoped enumeration
@@ -11,6 +12,9 @@
 #include <net/logicaladdress.h>
 #include <net/virtualaddress.h>
 #include <net/checksum.h>
+#include <net/gso.h>
+#include <net/ieee8021q.h>
+#include <net/returncontext.h>
 #include <initguid.h>
 #include <TraceLoggingProvider.h>
 #include <winmeta.h>
@@ -35,3 +35,128 @@ QueueDescriptorAddressToIndex(UINT32 address, PHYSICAL_ADDRESS descPhysical, UIN
     NT_ASSERT(address % QueueDescriptorSize == 0);
     return (address & (QueueDescriptorAlignment - 1)) / QueueDescriptorSize;
 }
+
+_Use_decl_annotations_ UINT32
+QueueDescriptorFindOwned(void const* descVirtual, UINT32 descBegin, UINT32 descEnd, UINT32 descCount)
+{
+    // DISPATCH_LEVEL
+    auto const descBytes = static_cast<UINT8 const*>(descVirtual);
+    auto const descMask = descCount - 1u;
+    UINT32 descIndex = descBegin;
+    while (descIndex != descEnd)
+    {
+        // DES3 is the 4th UINT32 of both Rx and Tx descriptors. Acquire so that reads
+        // of the rest of the descriptor are not ordered before the OWN check.
+        auto const des3 = ReadAcquire(reinterpret_cast<LONG const volatile*>(
+            descBytes + descIndex * QueueDescriptorSize + 3 * sizeof(UINT32)));
+        if (des3 < 0) // OWN = bit 31
+        {
+            break;
+        }
+
+        descIndex = (descIndex + 1) & descMask;
+    }
+
+    return descIndex;
+}
+
+static UINT16
+ReadBigEndian16(_In_reads_bytes_(2) UINT8 const* p)
+{
+    // Any IRQL
+    return static_cast<UINT16>((p[0] << 8) | p[1]);
+}
+
+_Use_decl_annotations_ bool
+QueuePtpEventMessage(UINT8 const* frame, UINT32 frameLength, PtpMessageId* id)
+{
+    // DISPATCH_LEVEL
+    UINT16 constexpr EtherTypeIPv4 = 0x0800;
+    UINT16 constexpr EtherTypeIPv6 = 0x86DD;
+    UINT16 constexpr EtherTypeVlan = 0x8100;
+    UINT16 constexpr EtherTypePtp = 0x88F7;
+    UINT8 constexpr IpProtocolUdp = 17;
+    UINT16 constexpr UdpPortPtpEvent = 319;
+    UINT32 constexpr PtpHeaderSize = 34;
+
+    *id = {};
+
+    UINT32 offset = 12; // EtherType
+    if (frameLength < offset + 2)
+    {
+        return false;
+    }
+
+    auto etherType = ReadBigEndian16(frame + offset);
+    if (etherType == EtherTypeVlan)
+    {
+        offset += 4;
+        if (frameLength < offset + 2)
+        {
+            return false;
+        }
+
+        etherType = ReadBigEndian16(frame + offset);
+    }
+
+    offset += 2;
+
+    UINT32 udpOffset;
+    if (etherType == EtherTypePtp)
+    {
+        udpOffset = 0;
+    }
+    else if (etherType == EtherTypeIPv4)
+    {
+        if (frameLength < offset + 20 ||
+            (frame[offset] >> 4) != 4 ||
+            (frame[offset] & 0xF) < 5 ||
+            frame[offset + 9] != IpProtocolUdp)
+        {
+            return false;
+        }
+
+        udpOffset = offset + (frame[offset] & 0xF) * 4u;
+    }
+    else if (etherType == EtherTypeIPv6)
+    {
+        if (frameLength < offset + 40 ||
+            frame[offset + 6] != IpProtocolUdp) // No extension headers.
+        {
+            return false;
+        }
+
+        udpOffset = offset + 40;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (udpOffset != 0)
+    {
+        if (frameLength < udpOffset + 8 ||
+            ReadBigEndian16(frame + udpOffset + 2) != UdpPortPtpEvent)
+        {
+            return false;
+        }
+
+        offset = udpOffset + 8;
+    }
+
+    if (frameLength < offset + PtpHeaderSize)
+    {
+        return false;
+    }
+
+    auto const messageType = frame[offset] & 0xF;
+    auto const version = frame[offset + 1] & 0xF;
+    if (version != 2 || messageType > 3) // 0..3 = event messages.
+    {
+        return false;
+    }
+
+    id->messageType = static_cast<UINT8>(messageType);
+    id->sequenceId = ReadBigEndian16(frame + offset + 30);
+    return true;
+}
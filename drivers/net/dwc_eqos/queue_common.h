@@ -24,3 +24,38 @@ QueueDescriptorCount(UINT32 fragmentCount);
 _IRQL_requires_max_(DISPATCH_LEVEL)
 UINT32
 QueueDescriptorAddressToIndex(UINT32 address, PHYSICAL_ADDRESS descPhysical, UINT32 descCount);
+
+// Returns the index of the first descriptor in [descBegin, descEnd) that is still
+// owned by the DMA engine (DES3.OWN set), or descEnd if there is none. Reads only
+// the descriptor ring (no MMIO). Descriptors before the returned index have been
+// written back and may be read without further synchronization.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+UINT32
+QueueDescriptorFindOwned(
+    _In_reads_bytes_(descCount * QueueDescriptorSize) void const* descVirtual,
+    UINT32 descBegin,
+    UINT32 descEnd,
+    UINT32 descCount);
+
+// Identifies a PTP message so that a packet timestamp can be matched to it.
+struct PtpMessageId
+{
+    UINT16 sequenceId;
+    UINT8 messageType;
+};
+
+// Bytes from the start of a frame that QueuePtpEventMessage may need: Ethernet header,
+// one VLAN tag, IPv4 header with options (larger than IPv6), UDP header and the PTP
+// common header.
+UINT32 constexpr QueuePtpFrameHeaderMax = 14 + 4 + 60 + 8 + 34;
+
+// Returns true and sets *id if frame is a PTPv2 event message (Sync, Delay_Req,
+// Pdelay_Req, Pdelay_Resp) over Ethernet, UDP/IPv4 or UDP/IPv6 (port 319). These are
+// the messages that the MAC timestamps on receive (see PtpStart). frameLength is the
+// number of contiguous bytes at frame; the headers must be within them.
+_IRQL_requires_max_(DISPATCH_LEVEL)
+bool
+QueuePtpEventMessage(
+    _In_reads_bytes_(frameLength) UINT8 const* frame,
+    UINT32 frameLength,
+    _Out_ PtpMessageId* id);
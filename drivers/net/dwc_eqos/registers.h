@@ -53,7 +53,9 @@ union ChannelDmaControl_t
         UINT32 PblX8 : 1; // PBLx8 - 8xPBL Mode
         UINT32 Reserved17 : 1;
         UINT32 DescriptorSkipLength : 3; // DSL - Descriptor Skip Length
-        UINT32 Reserved21 : 11;
+        UINT32 Reserved21 : 3;
+        UINT32 SplitHeader : 1; // SPH - Split Headers
+        UINT32 Reserved25 : 7;
     };
 };
 
@@ -90,6 +92,18 @@ union ChannelRxControl_t
     };
 };
 
+union ChannelRxInterruptWatchdog_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Timer : 8; // RWT - Receive Interrupt Watchdog Timer Count, 0 = disabled.
+        UINT32 Reserved8 : 8;
+        UINT32 Units : 2; // RWTU - Count units: 0 = 256, 1 = 512, 2 = 1024, 3 = 2048 clocks.
+        UINT32 Reserved18 : 14;
+    };
+};
+
 union ChannelInterruptEnable_t
 {
     UINT32 Value32;
@@ -219,7 +233,7 @@ struct ChannelRegisters
     // DMA_CHx_Rx_Interrupt_WD_Timer @ 0x38 = 0x0:
     // The Receive Interrupt Watchdog Timer register indicates the watchdog timeout
     // for Receive Interrupt (RI) from the DMA.
-    ULONG Rx_Interrupt_WD_Timer;
+    ChannelRxInterruptWatchdog_t Rx_Interrupt_WD_Timer;
 
     // DMA_CHx_Slot_Func_Ctrl_Status @ 0x3C = 0x7C0:
     // The Slot Function Control and Status register contains the control bits for
@@ -459,19 +473,56 @@ static_assert(sizeof(MacAddressRegisters) == 8);
 
 #pragma region MacL3L4Registers
 
+union MacL3L4Control_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 L3ProtocolIPv6 : 1;      // L3PEN - 0 = IPv4, 1 = IPv6
+        UINT32 Reserved1 : 1;
+        UINT32 L3SourceMatch : 1;       // L3SAM - Layer 3 IP SA Match Enable
+        UINT32 L3SourceInverse : 1;     // L3SAIM - Layer 3 IP SA Inverse Match Enable
+        UINT32 L3DestMatch : 1;         // L3DAM - Layer 3 IP DA Match Enable
+        UINT32 L3DestInverse : 1;       // L3DAIM - Layer 3 IP DA Inverse Match Enable
+        UINT32 L3SourceMaskBits : 5;    // L3HSBM - Number of low-order IP SA bits ignored
+        UINT32 L3DestMaskBits : 5;      // L3HDBM - Number of low-order IP DA bits ignored
+
+        UINT32 L4ProtocolUdp : 1;       // L4PEN - 0 = TCP, 1 = UDP
+        UINT32 Reserved17 : 1;
+        UINT32 L4SourcePortMatch : 1;   // L4SPM - Layer 4 Source Port Match Enable
+        UINT32 L4SourcePortInverse : 1; // L4SPIM - Layer 4 Source Port Inverse Match Enable
+        UINT32 L4DestPortMatch : 1;     // L4DPM - Layer 4 Destination Port Match Enable
+        UINT32 L4DestPortInverse : 1;   // L4DPIM - Layer 4 Destination Port Inverse Match Enable
+        UINT32 Reserved22 : 2;
+        UINT32 DmaChannel : 4;          // DMCHN - DMA Channel Number for matching packets
+        UINT32 DmaChannelEnable : 1;    // DMCHEN - DMA Channel Select Enable
+        UINT32 Reserved29 : 3;
+    };
+};
+
+union MacLayer4Address_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT16 SourcePort;  // L4SP
+        UINT16 DestPort;    // L4DP
+    };
+};
+
 struct MacL3L4Registers
 {
     // MAC_L3_L4_ControlX @ 0x00 = 0x0:
     // The Layer 3 and Layer 4 Control register controls the operations of filter X of
     // Layer 3 and Layer 4.
-    ULONG L3_L4_Control;
+    MacL3L4Control_t L3_L4_Control;
 
     // MAC_Layer4_AddressX @ 0x04 = 0x0:
     // The MAC_Layer4_Address, MAC_L3_L4_Control, MAC_Layer3_Addr0_Reg,
     // MAC_Layer3_Addr1_Reg, MAC_Layer3_Addr2_Reg and MAC_Layer3_Addr3_Reg
     // registers are reserved (RO with default value) if Enable Layer 3 and Layer 4
     // Packet Filter option is not selected while configuring the core.
-    ULONG Layer4_Address;
+    MacLayer4Address_t Layer4_Address;
 
     ULONG Padding08[2];
 
@@ -592,6 +643,15 @@ union MacConfiguration_t
     };
 };
 
+enum SplitHeaderMaxSize_t : UINT32
+{
+    SplitHeaderMaxSize1024 = 0,
+    SplitHeaderMaxSize512 = 1,
+    SplitHeaderMaxSize256 = 2,
+    SplitHeaderMaxSize128 = 3,
+    SplitHeaderMaxSize64 = 4,
+};
+
 union MacExtConfiguration_t
 {
     UINT32 Value32;
@@ -604,7 +664,7 @@ union MacExtConfiguration_t
         UINT32 SlowProtocolDetect : 1;
         UINT32 UnicastSlowProtocolPacketDetect : 1;
         UINT32 Reserved19 : 1;
-        UINT32 HeaderSplitMaxSize : 3;
+        SplitHeaderMaxSize_t HeaderSplitMaxSize : 3; // HDSMS
         UINT32 Reserved23 : 1;
         UINT32 ExtendedIpgEnable : 1;
         UINT32 ExtendedIpg : 5;
@@ -612,6 +672,118 @@ union MacExtConfiguration_t
     };
 };
 
+enum VlanStripOnReceive_t : UINT32
+{
+    VlanStripOnReceive_Never = 0,
+    VlanStripOnReceive_IfPassed = 1,
+    VlanStripOnReceive_IfFailed = 2,
+    VlanStripOnReceive_Always = 3,
+};
+
+// MAC_VLAN_Tag_Ctrl. Bits 15:0 are VL (tag for perfect filtering) if there are no
+// extended VLAN filters, or OB/CT/OFS (indirect access) otherwise.
+union MacVlanTagCtrl_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 VlanTag : 16; // VL or OB/CT/OFS
+        UINT32 Enable12BitVlanCompare : 1; // ETV
+        UINT32 VlanTagInverseMatch : 1; // VTIM
+        UINT32 EnableSVlan : 1; // ESVL
+        UINT32 EnableRxSVlanMatch : 1; // ERSVLM
+        UINT32 DisableVlanTypeCheck : 1; // DOVLTC
+        VlanStripOnReceive_t StripOnReceive : 2; // EVLS
+        UINT32 Reserved23 : 1;
+        UINT32 EnableRxStatus : 1; // EVLRXS
+        UINT32 VlanHashMatch : 1; // VTHM
+        UINT32 EnableDoubleVlan : 1; // EDVLP
+        UINT32 EnableInnerVlanMatch : 1; // ERIVLT
+        UINT32 InnerStripOnReceive : 2; // EIVLS
+        UINT32 Reserved30 : 1;
+        UINT32 EnableInnerRxStatus : 1; // EIVLRXS
+    };
+};
+
+union MacVlanIncl_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 VlanTag : 16; // VLT
+        UINT32 VlanTagControl : 2; // VLC
+        UINT32 VlanPriorityControl : 1; // VLP
+        UINT32 SVlan : 1; // CSVL
+        UINT32 VlanTagInput : 1; // VLTI - Use the tag from the Tx context descriptor.
+        UINT32 ChannelBasedInsertion : 1; // CBTI
+        UINT32 Reserved22 : 2;
+        UINT32 Address : 6; // ADDR
+        UINT32 ReadWriteControl : 1; // RDWR
+        UINT32 Busy : 1; // BUSY
+    };
+};
+
+enum TimestampSnapshotType_t : UINT32
+{
+    TimestampSnapshotType_0 = 0, // SYNC, Follow_Up, Delay_Req, Delay_Resp (depending on TSEVNTENA/TSMSTRENA).
+    TimestampSnapshotType_1 = 1, // SYNC, Delay_Req, Pdelay_Req, Pdelay_Resp (depending on TSEVNTENA/TSMSTRENA).
+    TimestampSnapshotType_2 = 2, // SYNC, Delay_Req (E2E), Pdelay_Req, Pdelay_Resp (P2P).
+    TimestampSnapshotType_3 = 3, // SYNC, Follow_Up, Delay_Req, Delay_Resp, Pdelay_Req, Pdelay_Resp, Pdelay_Resp_Follow_Up.
+};
+
+union MacTimestampControl_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Enable : 1; // TSENA
+        UINT32 FineUpdate : 1; // TSCFUPDT
+        UINT32 Initialize : 1; // TSINIT - Self-clearing.
+        UINT32 Update : 1; // TSUPDT - Self-clearing.
+        UINT32 Reserved4 : 1;
+        UINT32 AddendUpdate : 1; // TSADDREG - Self-clearing.
+        UINT32 Reserved6 : 2;
+        UINT32 EnableAll : 1; // TSENALL - Timestamp all received packets.
+        UINT32 DigitalRollover : 1; // TSCTRLSSR - Nanoseconds roll over at 999,999,999.
+        UINT32 PtpVersion2 : 1; // TSVER2ENA
+        UINT32 PtpOverEthernet : 1; // TSIPENA
+        UINT32 PtpOverIPv6 : 1; // TSIPV6ENA
+        UINT32 PtpOverIPv4 : 1; // TSIPV4ENA
+        UINT32 EventMessagesOnly : 1; // TSEVNTENA
+        UINT32 MasterMessages : 1; // TSMSTRENA
+        TimestampSnapshotType_t SnapshotType : 2; // SNAPTYPSEL
+        UINT32 MacAddressFilter : 1; // TSENMACADDR
+        UINT32 CheckSumCorrection : 1; // CSC
+        UINT32 Reserved20 : 4;
+        UINT32 TxTimestampStatusMode : 1; // TXTSSTSM
+        UINT32 Reserved25 : 3;
+        UINT32 Av8021AsMode : 1; // AV8021ASMEN
+        UINT32 Reserved29 : 3;
+    };
+};
+
+union MacSubSecondIncrement_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Reserved0 : 8;
+        UINT32 SubNanoseconds : 8; // SNSINC
+        UINT32 Nanoseconds : 8; // SSINC
+        UINT32 Reserved24 : 8;
+    };
+};
+
+union MacSysTimeNsUpdate_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Nanoseconds : 31; // TSSS
+        UINT32 Subtract : 1; // ADDSUB
+    };
+};
+
 union MacPacketFilter_t
 {
     UINT32 Value32;
@@ -639,6 +811,44 @@ union MacPacketFilter_t
     };
 };
 
+union MacPmtControlStatus_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 PowerDown : 1;           // PWRDWN - Power Down (cleared on wake-up)
+        UINT32 MagicPacketEnable : 1;   // MGKPKTEN - Magic Packet Enable
+        UINT32 RemoteWakeEnable : 1;    // RWKPKTEN - Remote Wake-Up Packet Enable
+        UINT32 Reserved3 : 2;
+        UINT32 MagicPacketReceived : 1; // MGKPRCVD - Magic Packet Received (cleared on read)
+        UINT32 RemoteWakeReceived : 1;  // RWKPRCVD - Remote Wake-Up Packet Received (cleared on read)
+        UINT32 Reserved7 : 2;
+        UINT32 GlobalUnicast : 1;       // GLBLUCAST - Any unicast packet is a wake-up packet
+        UINT32 RemoteWakeForward : 1;   // RWKPFE - Forward Remote Wake-Up Packets to the application
+        UINT32 Reserved11 : 13;
+        UINT32 RemoteWakePointer : 5;   // RWKPTR - Remote Wake-Up FIFO Pointer
+        UINT32 Reserved29 : 2;
+        UINT32 RemoteWakeFilterReset : 1; // RWKFILTRST - Reset RWKPTR to 0
+    };
+};
+
+enum MacRwkFilterCommand_t : UINT8
+{
+    MacRwkFilterCommand_Enable = 0x1,
+    MacRwkFilterCommand_Multicast = 0x8, // Address type: 1 = multicast/broadcast, 0 = unicast.
+};
+
+// Remote wake-up filters 0..3, written one UINT32 at a time to MAC_RWK_Packet_Filter
+// after setting MAC_PMT_Control_Status.RWKFILTRST.
+struct MacRwkFilterBlock
+{
+    UINT32 ByteMask[4];     // Bit N set = match byte (Offset + N). Bit 31 must be 0.
+    UINT8 Command[4];       // MacRwkFilterCommand_t
+    UINT8 Offset[4];        // Offset of the first byte of the pattern window.
+    UINT16 Crc16[4];        // CRC-16 of the masked bytes.
+};
+static_assert(sizeof(MacRwkFilterBlock) == 8 * sizeof(UINT32));
+
 union MacInterruptStatus_t
 {
     UINT32 Value32;
@@ -732,6 +942,47 @@ union MacLpiControlStatus_t
     };
 };
 
+union MacLpiTimersControl_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 WakeTimer : 16; // TWT - LPI TW Timer (microseconds)
+        UINT32 LinkStatusTimer : 10; // LST - LPI LS Timer (milliseconds)
+        UINT32 Reserved26 : 6;
+    };
+};
+
+enum MdioOperation_t : UINT32
+{
+    MdioOperation_Write = 1,
+    MdioOperation_PostReadIncrement = 2, // Clause 45 only.
+    MdioOperation_Read = 3,
+};
+
+union MacMdioAddress_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Busy : 1; // GB - GMII Busy
+        UINT32 Clause45Enable : 1; // C45E - Clause 45 PHY Enable
+        MdioOperation_t Operation : 2; // GOC - GMII Operation Command
+        UINT32 SkipAddressPacket : 1; // SKAP - Skip Address Packet
+        UINT32 Reserved5 : 3;
+
+        UINT32 CsrClockRange : 4; // CR - CSR Clock Range
+        UINT32 TrailingClocks : 3; // NTC - Number of Trailing Clocks
+        UINT32 Reserved15 : 1;
+
+        UINT32 RegisterAddress : 5; // RDA - Register/Device Address
+        UINT32 PhysicalLayerAddress : 5; // PA - Physical Layer Address
+        UINT32 BackToBack : 1; // BTB - Back to Back transactions
+        UINT32 PreambleSuppression : 1; // PSE - Preamble Suppression Enable
+        UINT32 Reserved28 : 4;
+    };
+};
+
 union MacVersion_t
 {
     UINT32 Value32;
@@ -876,6 +1127,77 @@ union DmaSysBusMode_t
     };
 };
 
+enum MacRxQueueEnable_t : UINT32
+{
+    MacRxQueueEnable_Disabled = 0,
+    MacRxQueueEnable_EnabledAV,
+    MacRxQueueEnable_EnabledDcb, // Enabled for DCB/generic.
+};
+
+union MacRxQCtrl0_t
+{
+    UINT32 Value32;
+    struct
+    {
+        MacRxQueueEnable_t RxQ0Enable : 2; // RXQ0EN - Receive Queue 0 Enable
+        MacRxQueueEnable_t RxQ1Enable : 2; // RXQ1EN - Receive Queue 1 Enable
+        UINT32 Reserved4 : 28;
+    };
+};
+
+union MacRxQCtrl1_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 AvControlQueue : 3; // AVCPQ - AV Untagged Control Packets Queue
+        UINT32 Reserved3 : 1;
+        UINT32 PtpQueue : 3; // PTPQ - PTP Packets Queue
+        UINT32 Reserved7 : 1;
+        UINT32 DcbControlQueue : 3; // DCBCPQ - DCB Control Packets Queue
+        UINT32 Reserved11 : 1;
+        UINT32 UntaggedQueue : 3; // UPQ - Untagged Packet Queue
+        UINT32 Reserved15 : 1;
+
+        UINT32 MulticastBroadcastQueue : 3; // MCBCQ - Multicast and Broadcast Queue
+        UINT32 Reserved19 : 1;
+        UINT32 MulticastBroadcastQueueEnable : 1; // MCBCQEN - Multicast and Broadcast Queue Enable
+        UINT32 TaggedAvControlQueueEnable : 1; // TACPQE - Tagged AV Control Packets Queuing Enable
+        UINT32 TaggedPtpQueueControl : 2; // TPQC - Tagged PTP over Ethernet Packets Queuing Control
+        UINT32 FramePreemptionResidueQueue : 3; // FPRQ - Frame Preemption Residue Queue
+        UINT32 Reserved27 : 5;
+    };
+};
+
+union MtlRxQDmaMap0_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Q0Channel : 4; // Q0MDMACH - Queue 0 Mapped to DMA Channel
+        UINT32 Q0DynamicChannel : 1; // Q0DDMACH - Queue 0 Enabled for DA-based DMA Channel Selection
+        UINT32 Reserved5 : 3;
+        UINT32 Q1Channel : 4; // Q1MDMACH - Queue 1 Mapped to DMA Channel
+        UINT32 Q1DynamicChannel : 1; // Q1DDMACH - Queue 1 Enabled for DA-based DMA Channel Selection
+        UINT32 Reserved13 : 19;
+    };
+};
+
+union DmaInterruptStatus_t
+{
+    UINT32 Value32;
+    struct
+    {
+        UINT32 Channel0 : 1; // DC0IS - DMA Channel 0 Interrupt Status
+        UINT32 Channel1 : 1; // DC1IS - DMA Channel 1 Interrupt Status
+        UINT32 Reserved2 : 14;
+
+        UINT32 Mtl : 1; // MTLIS - MTL Interrupt Status
+        UINT32 Mac : 1; // MACIS - MAC Interrupt Status
+        UINT32 Reserved18 : 14;
+    };
+};
+
 union MacTxFlowCtrl_t
 {
     UINT32 Value32;
@@ -916,15 +1238,16 @@ struct MacRegisters
 
     // MAC_Hash_Table_RegX @ 0x0010 = 0x0:
     // The Hash Table Register X contains the Xth 32 bits of the hash table.
-    ULONG MAC_Hash_Table_Reg[3];
+    // Number of registers in use depends on MAC_HW_Feature1\HASHTBLSZ (64 bits = 2 registers).
+    ULONG MAC_Hash_Table_Reg[8];
 
-    ULONG Padding001C[13];
+    ULONG Padding0030[8];
 
     // MAC_VLAN_Tag_Ctrl @ 0x0050 = 0x0:
     // This register is the redefined format of the MAC VLAN Tag Register. It is used
     // for indirect addressing. It contains the address offset, command type and Busy
     // Bit for CSR access of the Per VLAN Tag registers.
-    ULONG Mac_Vlan_Tag_Ctrl;
+    MacVlanTagCtrl_t Mac_Vlan_Tag_Ctrl;
 
     // MAC_VLAN_Tag_Data @ 0x0054 = 0x0:
     // This register holds the read/write data for Indirect Access of the Per VLAN Tag
@@ -944,7 +1267,7 @@ struct MacRegisters
     // The VLAN Tag Inclusion or Replacement register contains the VLAN tag for
     // insertion or replacement in the Transmit packets. It also contains the VLAN tag
     // insertion controls.
-    ULONG Mac_Vlan_Incl;
+    MacVlanIncl_t Mac_Vlan_Incl;
 
     // MAC_Inner_VLAN_Incl @ 0x0064 = 0x0:
     // The Inner VLAN Tag Inclusion or Replacement register contains the inner VLAN
@@ -977,12 +1300,12 @@ struct MacRegisters
     // MAC_RxQ_Ctrl0 @ 0x00A0 = 0x0:
     // The Receive Queue Control 0 register controls the queue management in the MAC
     // Receiver.
-    ULONG Mac_RxQ_Ctrl0;
+    MacRxQCtrl0_t Mac_RxQ_Ctrl0;
 
     // MAC_RxQ_Ctrl1 @ 0x00A4 = 0x0:
     // The Receive Queue Control 1 register controls the routing of multicast,
     // broadcast, AV, DCB, and untagged packets to the Rx queues.
-    ULONG Mac_RxQ_Ctrl1;
+    MacRxQCtrl1_t Mac_RxQ_Ctrl1;
 
     // MAC_RxQ_Ctrl2 @ 0x00A8 = 0x0:
     // This register controls the routing of tagged packets based on the USP (user
@@ -1008,7 +1331,7 @@ struct MacRegisters
 
     // MAC_PMT_Control_Status @ 0x00C0 = 0x0:
     // The PMT Control and Status Register.
-    ULONG Mac_Pmt_Control_Status;
+    MacPmtControlStatus_t Mac_Pmt_Control_Status;
 
     // MAC_RWK_Packet_Filter @ 0x00C4 = 0x0:
     // The Remote Wakeup Filter registers are implemented as 8, 16, or 32 indirect
@@ -1058,7 +1381,7 @@ struct MacRegisters
 
     // MAC_LPI_Timers_Control @ 0x00D4 = 0x3E80000:
     // The LPI Timers Control register controls the timeout values in the LPI states.
-    ULONG Mac_Lpi_Timers_Control;
+    MacLpiTimersControl_t Mac_Lpi_Timers_Control;
 
     // MAC_LPI_Entry_Timer @ 0x00D8 = 0x0:
     // This register controls the Tx LPI entry timer.
@@ -1112,7 +1435,7 @@ struct MacRegisters
     // MAC_MDIO_Address @ 0x0200 = 0x0:
     // The MDIO Address register controls the management cycles to external PHY
     // through a management interface.
-    ULONG Mac_Mdio_Address;
+    MacMdioAddress_t Mac_Mdio_Address;
 
     // MAC_MDIO_Data @ 0x0204 = 0x0:
     // The MDIO Data register stores the Write data to be written to the PHY register
@@ -1289,7 +1612,25 @@ struct MacRegisters
     // programmed in the MAC_Watchdog_Timeout register).
     ULONG Rx_Watchdog_Error_Packets;
 
-    ULONG Padding07E0[8];
+    ULONG Padding07E0[3];
+
+    // Tx_LPI_USEC_Cntr @ 0x07EC = 0x0:
+    // This register provides the number of microseconds Tx LPI is asserted.
+    ULONG Tx_Lpi_Usec_Cntr;
+
+    // Tx_LPI_Tran_Cntr @ 0x07F0 = 0x0:
+    // This register provides the number of times the MAC has entered Tx LPI.
+    ULONG Tx_Lpi_Tran_Cntr;
+
+    // Rx_LPI_USEC_Cntr @ 0x07F4 = 0x0:
+    // This register provides the number of microseconds Rx LPI is sampled.
+    ULONG Rx_Lpi_Usec_Cntr;
+
+    // Rx_LPI_Tran_Cntr @ 0x07F8 = 0x0:
+    // This register provides the number of times the MAC has entered Rx LPI.
+    ULONG Rx_Lpi_Tran_Cntr;
+
+    ULONG Padding07FC[1];
 
     // MMC_IPC_Rx_Interrupt_Mask @ 0x0800 = 0x0:
     // This register maintains the mask for the interrupt generated from the receive
@@ -1447,12 +1788,12 @@ struct MacRegisters
     // MAC_Timestamp_Control @ 0x0B00 = 0x0:
     // This register controls the operation of the System Time generator and
     // processing of PTP packets for timestamping in the Receiver.
-    ULONG Mac_Timestamp_Control;
+    MacTimestampControl_t Mac_Timestamp_Control;
 
     // MAC_Sub_Second_Increment @ 0x0B04 = 0x0:
     // Specifies the value to be added to the internal system time register every
     // cycle of clk_ptp_ref_i clock.
-    ULONG Mac_Sub_Second_Increment;
+    MacSubSecondIncrement_t Mac_Sub_Second_Increment;
 
     // MAC_System_Time_Secs @ 0x0B08 = 0x0:
     // The System Time Nanoseconds register, along with System Time Seconds register,
@@ -1471,7 +1812,7 @@ struct MacRegisters
 
     // MAC_Sys_Time_NS_Update @ 0x0B14 = 0x0:
     // MAC System Time Nanoseconds Update register.
-    ULONG Mac_Sys_Time_NS_Update;
+    MacSysTimeNsUpdate_t Mac_Sys_Time_NS_Update;
 
     // MAC_Timestamp_Addend @ 0x0B18 = 0x0:
     // Timestamp Addend register.  This register value is used only when the system
@@ -1602,7 +1943,7 @@ struct MacRegisters
     // MTL_RxQ_DMA_Map0 @ 0x0C30 = 0x0:
     // The Receive Queue and DMA Channel Mapping 0 register is reserved in EQOS-CORE
     // and EQOS-MTL configurations.
-    ULONG Mtl_RxQ_Dma_Map0;
+    MtlRxQDmaMap0_t Mtl_RxQ_Dma_Map0;
 
     ULONG Padding0C34[3];
 
@@ -1692,7 +2033,7 @@ struct MacRegisters
     // The application reads this Interrupt Status register during interrupt service
     // routine or polling to determine the interrupt status of DMA channels, MTL
     // queues, and the MAC.
-    ULONG Dma_Interrupt_Status;
+    DmaInterruptStatus_t Dma_Interrupt_Status;
 
     // DMA_Debug_Status0 @ 0x100C = 0x0:
     // The Debug Status 0 register gives the Receive and Transmit process status for
@@ -8,6 +8,48 @@
 
 static_assert(sizeof(RxDescriptor) == QueueDescriptorSize);
 
+/*
+Rx interrupt moderation: IOC is set on one of every iocInterval descriptors, and
+the Rx interrupt watchdog bounds the latency for the remaining descriptors. The
+level is chosen from the packet rate measured over RxModerationSampleTime.
+*/
+struct RxModerationLevel
+{
+    UINT16 iocInterval;     // Power of 2.
+    UINT8 watchdogTimer;    // Rx_Interrupt_WD_Timer.Timer in units of 256 clocks (~2us at 125MHz), 0 = disabled.
+    UINT32 minPacketRate;   // Packets per second.
+};
+static RxModerationLevel constexpr RxModerationLevels[] = {
+    {  1,  0,       0 },
+    {  4, 16,  10'000 },    // ~33us
+    { 16, 32,  50'000 },    // ~66us
+    { 64, 64, 150'000 },    // ~131us
+};
+static UINT8 constexpr RxModerationLevelMin[RxInterruptModerationMax] = { 0, 0, 1 };
+static UINT8 constexpr RxModerationLevelMax[RxInterruptModerationMax] = { 0, 2, 3 };
+static UINT32 constexpr RxModerationSampleTime = 100'000; // 10ms in KeQueryInterruptTime units.
+
+/*
+Driver-managed Rx buffers (RxCopyBreak != 0): each descriptor always has a DMA buffer
+attached. When a packet is indicated, frames up to copyBreak bytes are copied into a
+small buffer and the DMA buffer stays on the descriptor. Larger frames are indicated
+in place and a spare DMA buffer from the pool takes their place on the descriptor.
+NetAdapterCx returns indicated buffers via RxQueueReturnBuffer, which puts them back
+on the free list. If no spare is available, the packet is dropped and its buffers are
+reused, so the descriptor ring never runs dry.
+*/
+struct RxQueueContext;
+struct RxBuffer
+{
+    UINT8* virtualAddress;
+    UINT64 logicalAddress;
+    RxQueueContext* context;
+    bool small;     // In smallFree pool (copy-break buffer, not DMA).
+};
+static UINT32 constexpr RxBufferChunkSize = 0x10000; // Common buffer allocation granularity.
+static UINT32 constexpr RxBuffersPerChunk = RxBufferChunkSize / RxBufferSize;
+static UINT32 constexpr RxSmallBufferAlignment = 64;
+
 struct RxQueueContext
 {
     ChannelRegisters* channelRegs;
@@ -19,10 +61,36 @@ struct RxQueueContext
     RxDescriptor* descVirtual;
     PHYSICAL_ADDRESS descPhysical;
     NET_EXTENSION packetChecksum;
+    NET_EXTENSION packetIeee8021q;
     NET_EXTENSION fragmentLogical;
     UINT32 descCount;   // A power of 2 between QueueDescriptorMinCount and QueueDescriptorMaxCount.
+    UINT8 channel;      // DMA channel (and MTL queue) index.
     UINT8 rxPbl;
     bool running;
+    bool rxVlanTag;         // Tags are stripped by MAC and reported via packetIeee8021q.
+    bool ptpTimestamp;      // PTP event messages are followed by a timestamp context descriptor.
+    bool ptpPending;        // The most recent packet was a PTP event message with TSA set.
+    PtpMessageId ptpPendingId; // Identity of that message, for its timestamp context descriptor.
+    bool splitHeader;       // Each descriptor has 2 fragments: Buf1 = headers, Buf2 = payload.
+    UINT8 l3l4DropFilters;  // Bit N set = packets matching L3/L4 filter N are dropped.
+    UINT8 moderation;       // RxInterruptModeration.
+    UINT8 moderationLevel;  // Index into RxModerationLevels.
+    UINT32 iocMask;         // Set IOC when (descIndex & iocMask) == iocMask.
+    UINT32 samplePackets;   // Packets indicated since sampleStart.
+    UINT64 sampleStart;     // KeQueryInterruptTime.
+
+    NET_EXTENSION fragmentVirtual; // Only if copyBreak or ptpTimestamp.
+
+    // Driver-managed buffers.
+    NET_EXTENSION fragmentReturn;
+    UINT16 copyBreak;       // 0 = system-managed buffers (none of the fields below are used).
+    UINT16 smallSize;       // Capacity of small buffers.
+    WDFSPINLOCK bufferLock; // Protects dmaFree and smallFree (buffers are returned from any thread).
+    RxBuffer** descBuffers; // DMA buffer attached to each descriptor.
+    RxBuffer** dmaFree;     // Spare DMA buffers.
+    RxBuffer** smallFree;   // Spare copy-break buffers.
+    UINT32 dmaFreeCount;
+    UINT32 smallFreeCount;
 
     UINT32 descBegin;   // Start of the RECEIVE region.
     UINT32 descEnd;     // End of the RECEIVE region, start of the EMPTY region.
@@ -51,6 +119,208 @@ SetDescEnd(
     context->descEnd = index;
 }
 
+// Applies the IOC interval and watchdog for the given moderation level.
+static void
+RxModerationSet(
+    _In_ RxQueueContext* context,
+    _In_ UINT8 level)
+{
+    // DISPATCH_LEVEL
+    NT_ASSERT(level < ARRAYSIZE(RxModerationLevels));
+    auto const& settings = RxModerationLevels[level];
+    context->moderationLevel = level;
+    context->iocMask = min(settings.iocInterval, context->descCount / 4u) - 1u;
+
+    ChannelRxInterruptWatchdog_t watchdog = {};
+    watchdog.Timer = settings.watchdogTimer;
+    watchdog.Units = 0; // 256 clocks
+    Write32(&context->channelRegs->Rx_Interrupt_WD_Timer, watchdog);
+
+    TraceWrite("RxModerationSet", LEVEL_VERBOSE,
+        TraceLoggingUInt8(context->channel, "channel"),
+        TraceLoggingUInt8(level),
+        TraceLoggingUInt32(context->iocMask + 1u, "iocInterval"));
+}
+
+// Measures the packet rate and updates the moderation level.
+static void
+RxModerationUpdate(
+    _In_ RxQueueContext* context,
+    _In_ UINT32 packets)
+{
+    // DISPATCH_LEVEL
+    context->samplePackets += packets;
+
+    auto const now = KeQueryInterruptTime();
+    auto const elapsed = now - context->sampleStart;
+    if (elapsed < RxModerationSampleTime)
+    {
+        return;
+    }
+
+    auto const rate = context->samplePackets * 10'000'000ull / elapsed;
+    context->samplePackets = 0;
+    context->sampleStart = now;
+
+    auto const levelMin = RxModerationLevelMin[context->moderation];
+    auto level = RxModerationLevelMax[context->moderation];
+    while (level > levelMin && rate < RxModerationLevels[level].minPacketRate)
+    {
+        level -= 1;
+    }
+
+    if (level != context->moderationLevel)
+    {
+        RxModerationSet(context, level);
+    }
+}
+
+// Driver-managed buffers: attaches the buffers of a received packet to the fragments
+// starting at fragIndex, either by copying into a small buffer or by swapping each
+// descriptor's DMA buffer with a spare. Returns false if no buffers are available.
+static bool
+AttachBuffers(
+    _In_ RxQueueContext* context,
+    _In_ UINT32 descIndex,
+    _In_ UINT32 descPacket,
+    _In_ UINT32 length,
+    _In_ UINT32 fragIndex)
+{
+    // DISPATCH_LEVEL
+    auto const descMask = context->descCount - 1u;
+    RxBuffer* small = nullptr;
+    bool attached = true;
+
+    WdfSpinLockAcquire(context->bufferLock);
+    if (descPacket == 1 && length <= context->copyBreak && context->smallFreeCount != 0)
+    {
+        context->smallFreeCount -= 1;
+        small = context->smallFree[context->smallFreeCount];
+    }
+    else if (context->dmaFreeCount >= descPacket)
+    {
+        for (UINT32 i = 0; i != descPacket; i += 1)
+        {
+            auto const index = (descIndex + i) & descMask;
+            auto const returnContext = NetExtensionGetFragmentReturnContext(
+                &context->fragmentReturn,
+                NetRingAdvanceIndex(context->fragmentRing, fragIndex, i));
+            returnContext->Handle = reinterpret_cast<NET_FRAGMENT_RETURN_CONTEXT_HANDLE>(context->descBuffers[index]);
+            context->dmaFreeCount -= 1;
+            context->descBuffers[index] = context->dmaFree[context->dmaFreeCount];
+        }
+    }
+    else
+    {
+        attached = false;
+    }
+    WdfSpinLockRelease(context->bufferLock);
+
+    if (!attached)
+    {
+        return false;
+    }
+
+    if (small != nullptr)
+    {
+        memcpy(small->virtualAddress, context->descBuffers[descIndex]->virtualAddress, length);
+
+        auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+        frag->Capacity = context->smallSize;
+        frag->Offset = 0;
+        frag->ValidLength = length;
+        NetExtensionGetFragmentVirtualAddress(&context->fragmentVirtual, fragIndex)->VirtualAddress = small->virtualAddress;
+        NetExtensionGetFragmentReturnContext(&context->fragmentReturn, fragIndex)->Handle =
+            reinterpret_cast<NET_FRAGMENT_RETURN_CONTEXT_HANDLE>(small);
+        return true;
+    }
+
+    // Each descriptor except the last is filled to RxBufferSize.
+    for (UINT32 i = 0; i != descPacket; i += 1)
+    {
+        auto const buffer = reinterpret_cast<RxBuffer*>(
+            NetExtensionGetFragmentReturnContext(&context->fragmentReturn, fragIndex)->Handle);
+        auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+        frag->Capacity = RxBufferSize;
+        frag->Offset = 0;
+        frag->ValidLength = min(length, RxBufferSize);
+        length -= static_cast<UINT32>(frag->ValidLength);
+        NetExtensionGetFragmentVirtualAddress(&context->fragmentVirtual, fragIndex)->VirtualAddress = buffer->virtualAddress;
+
+        fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+    }
+
+    return true;
+}
+
+_Use_decl_annotations_ void
+RxQueueReturnBuffer(NET_FRAGMENT_RETURN_CONTEXT_HANDLE returnContext)
+{
+    // DISPATCH_LEVEL
+    auto const buffer = reinterpret_cast<RxBuffer*>(returnContext);
+
+    // Fragments released by cancel carry no buffer (see RxQueueAdvance).
+    if (buffer == nullptr)
+    {
+        return;
+    }
+
+    auto const context = buffer->context;
+    WdfSpinLockAcquire(context->bufferLock);
+    if (buffer->small)
+    {
+        NT_ASSERT(context->smallFreeCount < context->descCount);
+        context->smallFree[context->smallFreeCount] = buffer;
+        context->smallFreeCount += 1;
+    }
+    else
+    {
+        // dmaFree ends where smallFree begins (see RxQueueCreateBuffers).
+        NT_ASSERT(context->dmaFree + context->dmaFreeCount < context->smallFree);
+        context->dmaFree[context->dmaFreeCount] = buffer;
+        context->dmaFreeCount += 1;
+    }
+    WdfSpinLockRelease(context->bufferLock);
+}
+
+// Returns true and sets *id if the good packet at descIndex/fragIndex is a PTP event
+// message. Must be called before the packet's buffers are attached (copy-break) or
+// indicated. length = frame length excluding CRC.
+static bool
+RxPtpEventMessage(
+    _In_ RxQueueContext const* context,
+    UINT32 descIndex,
+    UINT32 fragIndex,
+    RxDescriptorWrite const& descLast,
+    UINT32 length,
+    _Out_ PtpMessageId* id)
+{
+    // DISPATCH_LEVEL
+    UINT8 const* const buf1 = context->copyBreak != 0
+        ? context->descBuffers[descIndex]->virtualAddress
+        : static_cast<UINT8 const*>(NetExtensionGetFragmentVirtualAddress(&context->fragmentVirtual, fragIndex)->VirtualAddress);
+    UINT32 buf1Length = min(length, RxBufferSize);
+
+    if (context->splitHeader && descLast.Rdes2Valid &&
+        descLast.L3L4HeaderLength != 0 && descLast.L3L4HeaderLength < length)
+    {
+        // Buf1 holds only the headers that the MAC found. The PTP header is in Buf2.
+        buf1Length = descLast.L3L4HeaderLength;
+        if (buf1Length < QueuePtpFrameHeaderMax)
+        {
+            UINT8 headers[QueuePtpFrameHeaderMax];
+            auto const buf2 = static_cast<UINT8 const*>(NetExtensionGetFragmentVirtualAddress(
+                &context->fragmentVirtual, NetRingIncrementIndex(context->fragmentRing, fragIndex))->VirtualAddress);
+            auto const buf2Length = min(length - buf1Length, QueuePtpFrameHeaderMax - buf1Length);
+            memcpy(headers, buf1, buf1Length);
+            memcpy(headers + buf1Length, buf2, buf2Length);
+            return QueuePtpEventMessage(headers, buf1Length + buf2Length, id);
+        }
+    }
+
+    return QueuePtpEventMessage(buf1, buf1Length, id);
+}
+
 static EVT_PACKET_QUEUE_START RxQueueStart;
 static void
 RxQueueStart(_In_ NETPACKETQUEUE queue)
@@ -59,8 +329,12 @@ RxQueueStart(_In_ NETPACKETQUEUE queue)
     auto const context = RxQueueGetContext(queue);
 
     context->running = true;
+    context->ptpPending = false;
     context->descBegin = 0;
     context->descEnd = 0;
+    context->samplePackets = 0;
+    context->sampleStart = KeQueryInterruptTime();
+    RxModerationSet(context, RxModerationLevelMin[context->moderation]);
 
     Write32(&context->channelRegs->RxDesc_List_Address_Hi, context->descPhysical.HighPart);
     Write32(&context->channelRegs->RxDesc_List_Address, context->descPhysical.LowPart);
@@ -78,6 +352,8 @@ RxQueueStart(_In_ NETPACKETQUEUE queue)
     rxControl.RxPbl = context->rxPbl;
     Write32(&context->channelRegs->Rx_Control, rxControl);
 
+    DeviceSetRxQueueStarted(context->deviceContext, context->channel, true);
+
     TraceEntryExit(RxQueueStart, LEVEL_INFO);
 }
 
@@ -91,7 +367,8 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
     auto const fragEnd = context->fragmentRing->EndIndex;
     auto const descMask = context->descCount - 1u;
     UINT32 descIndex, pktIndex, fragIndex;
-    UINT32 ownDescriptors = 0, doneFrags = 0, queuedFrags = 0;
+    UINT32 ownDescriptors = 0, doneFrags = 0, donePackets = 0, queuedFrags = 0;
+    UINT32 filterMatches[L3L4FiltersMax] = {};
 
     /*
     Fragment indexes:
@@ -106,91 +383,198 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
     pktIndex = context->packetRing->BeginIndex;
     fragIndex = context->fragmentRing->BeginIndex;
 
-    auto const descNext = GetDescNext(context);
-    for (descIndex = context->descBegin; descIndex != descNext; descIndex = (descIndex + 1) & descMask)
+    /*
+    A packet occupies one or more descriptors (one fragment per descriptor): FD is set
+    on the first, LD is set on the last. Frames larger than RxBufferSize (jumbo frames)
+    span multiple descriptors. Status (RDES1, error summary, packet length) is only
+    valid in the LD descriptor. If the LD descriptor has not been written back yet,
+    leave the whole packet for the next call.
+    */
+
+    // The RECEIVED region ends at the first descriptor still owned by the DMA engine.
+    // Current_App_RxDesc is only read when nothing was received, to detect descriptors
+    // that the DMA engine has passed but whose write-back is not yet visible.
+    auto const descNext = QueueDescriptorFindOwned(context->descVirtual, context->descBegin, context->descEnd, context->descCount);
+    if (descNext == context->descBegin && descNext != context->descEnd)
     {
-        NT_ASSERT(fragIndex != fragEnd);
+        auto const descCurrent = GetDescNext(context);
+        if (descCurrent != descNext)
+        {
+            TraceWrite("RxQueueAdvance-writeback-pending", LEVEL_VERBOSE,
+                TraceLoggingUInt32(descNext, "descIndex"),
+                TraceLoggingUInt32(descCurrent, "descCurrent"));
+            ownDescriptors = 1;
+        }
+    }
+
+    auto const descReceived = (descNext - context->descBegin) & descMask;
+    descIndex = context->descBegin;
+    while (descIndex != descNext)
+    {
+        NT_ASSERT(context->copyBreak != 0 || fragIndex != fragEnd);
         if (pktIndex == pktEnd || fragIndex == fragEnd)
         {
             break;
         }
 
-        auto const& desc = context->descVirtual[descIndex];
-        auto const descWrite = desc.Write;
+        // Find the end of the packet.
 
-        // Descriptor is still owned by the DMA engine?
-        NT_ASSERT(!descWrite.Own);
-        if (descWrite.Own)
+        auto const descReady = (descNext - descIndex) & descMask;
+        UINT32 descPacket = 0; // Number of descriptors (fragments) in the packet.
+        RxDescriptorWrite descLast = {};
+        bool packetComplete;
+        for (;;)
         {
-            /*
-            This sometimes happens with transmit descriptors (DMA race).
-            I've never seen it happen with receive descriptors, but if it does, breaking out here
-            is the right way to deal with it.
-            */
-            TraceWrite("RxQueueAdvance-own", LEVEL_WARNING,
-                TraceLoggingUInt32(descIndex, "descIndex"),
-                TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "RDES3"));
-            ownDescriptors = 1;
-            break;
+            auto const descWrite = context->descVirtual[(descIndex + descPacket) & descMask].Write;
+
+            // Descriptor is still owned by the DMA engine?
+            NT_ASSERT(!descWrite.Own);
+            if (descWrite.Own)
+            {
+                /*
+                This sometimes happens with transmit descriptors (DMA race).
+                I've never seen it happen with receive descriptors, but if it does, breaking out here
+                is the right way to deal with it.
+                */
+                TraceWrite("RxQueueAdvance-own", LEVEL_WARNING,
+                    TraceLoggingUInt32((descIndex + descPacket) & descMask, "descIndex"),
+                    TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "RDES3"));
+                ownDescriptors = 1;
+                goto IndicateDone;
+            }
+
+            if (descPacket != 0 && (descWrite.FirstDescriptor || descWrite.ContextType))
+            {
+                // Previous packet was truncated (no LD). Indicate it without this descriptor.
+                packetComplete = false;
+                break;
+            }
+
+            descLast = descWrite;
+            descPacket += 1;
+
+            if (descWrite.ContextType || (descPacket == 1 && !descWrite.FirstDescriptor))
+            {
+                // Unexpected descriptor. Indicate it by itself.
+                packetComplete = false;
+                break;
+            }
+
+            if (descWrite.LastDescriptor)
+            {
+                packetComplete = true;
+                break;
+            }
+
+            if (descPacket == descReady)
+            {
+                if (context->running)
+                {
+                    // Rest of the packet is still being received.
+                    goto IndicateDone;
+                }
+
+                // Stopped mid-packet. Return the partial packet so cancel can complete.
+                packetComplete = false;
+                break;
+            }
         }
 
-        NT_ASSERT(descWrite.FragmentIndex == fragIndex);
+        if (context->copyBreak != 0 &&
+            NetRingGetRangeCount(context->fragmentRing, fragIndex, fragEnd) < descPacket)
+        {
+            // Not enough fragments for the whole packet. Wait for NetAdapterCx to free some.
+            goto IndicateDone;
+        }
 
         auto const pkt = NetRingGetPacketAtIndex(context->packetRing, pktIndex);
         pkt->FragmentIndex = fragIndex;
-        pkt->FragmentCount = 1;
+        pkt->FragmentCount = static_cast<UINT16>(context->splitHeader ? descPacket * 2u : descPacket);
         pkt->Layout = {};
 
-        auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
-        frag->Offset = 0;
-        NT_ASSERT(RxBufferSize <= frag->Capacity);
+        UINT32 remaining; // Bytes not yet assigned to a fragment.
+        bool ignore = !packetComplete || descLast.ErrorSummary;
+        bool const filterMatch = !ignore &&
+            descLast.Rdes2Valid &&
+            (descLast.L3FilterMatch | descLast.L4FilterMatch) &&
+            descLast.L3L4FilterNumber < L3L4FiltersMax;
+        if (filterMatch)
+        {
+            filterMatches[descLast.L3L4FilterNumber] += 1;
+        }
 
-        if (descWrite.ErrorSummary ||
-            descWrite.ContextType ||
-            !descWrite.FirstDescriptor ||
-            !descWrite.LastDescriptor) // TODO: Jumbo frames (multi-descriptor packets)
+        if (filterMatch && (context->l3l4DropFilters & (1u << descLast.L3L4FilterNumber)))
+        {
+            // Drop filter (see DeviceL3L4FilterSet).
+            ignore = true;
+            remaining = 0;
+        }
+        else if (ignore)
         {
-            if (descWrite.ErrorSummary)
+            if (descLast.ContextType && descPacket == 1)
+            {
+                // Timestamp of the previous packet (PTP event message). Indicated as
+                // a dropped packet. All-ones means the timestamp is corrupt.
+                auto const descContext = context->descVirtual[descIndex].Context;
+                if (context->ptpPending &&
+                    (descContext.TimestampHigh & descContext.TimestampLow) != 0xFFFFFFFF)
+                {
+                    DeviceSetPacketTimestamp(context->deviceContext, false,
+                        context->ptpPendingId.messageType, context->ptpPendingId.sequenceId,
+                        descContext.TimestampHigh, descContext.TimestampLow);
+                }
+
+                context->ptpPending = false;
+            }
+            else if (descLast.ErrorSummary)
             {
                 TraceWrite("RxQueueAdvance-Dropped", LEVEL_INFO,
                     TraceLoggingUInt32(descIndex, "descIndex"),
-                    TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "RDES3"));
+                    TraceLoggingUInt32(descPacket, "descPacket"),
+                    TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descLast)[3], "RDES3"));
             }
             else
             {
                 TraceWrite("RxQueueAdvance-Unexpected", LEVEL_WARNING,
                     TraceLoggingUInt32(descIndex, "descIndex"),
-                    TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "RDES3"));
+                    TraceLoggingUInt32(descPacket, "descPacket"),
+                    TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descLast)[3], "RDES3"));
             }
 
-            pkt->Ignore = true;
-            frag->ValidLength = 0;
+            remaining = 0;
         }
         else
         {
-            NT_ASSERT(descWrite.PacketLength >= 4); // PacketLength includes CRC
-            frag->ValidLength = descWrite.PacketLength - 4;
+            NT_ASSERT(descLast.PacketLength >= 4); // PacketLength includes CRC
+            NT_ASSERT(descLast.PacketLength <= descPacket * RxBufferSize);
+            remaining = descLast.PacketLength >= 4 ? descLast.PacketLength - 4u : 0u;
+
+            // TSA: the next descriptor is this packet's timestamp. Remember which
+            // message it belongs to.
+            context->ptpPending = context->ptpTimestamp &&
+                descLast.Rdes1Valid && descLast.TimestampAvailable &&
+                RxPtpEventMessage(context, descIndex, fragIndex, descLast, remaining, &context->ptpPendingId);
 
             // If checksum offload is disabled by hardware then no IP headers will be
             // detected. If checksum offload is disabled by software then NetAdapterCx
             // will ignore our evaluation.
-            if (descWrite.IPv4HeaderPresent | descWrite.IPv6HeaderPresent)
+            if (descLast.IPv4HeaderPresent | descLast.IPv6HeaderPresent)
             {
                 auto const checksum = NetExtensionGetPacketChecksum(&context->packetChecksum, pktIndex);
                 checksum->Layer2 = NetPacketRxChecksumEvaluationValid;
                 pkt->Layout.Layer2Type = NetPacketLayer2TypeEthernet;
 
-                checksum->Layer3 = descWrite.IPHeaderError
+                checksum->Layer3 = descLast.IPHeaderError
                     ? NetPacketRxChecksumEvaluationInvalid
                     : NetPacketRxChecksumEvaluationValid;
-                pkt->Layout.Layer3Type = descWrite.IPv4HeaderPresent
+                pkt->Layout.Layer3Type = descLast.IPv4HeaderPresent
                     ? NetPacketLayer3TypeIPv4UnspecifiedOptions
                     : NetPacketLayer3TypeIPv6UnspecifiedExtensions;
 
-                checksum->Layer4 = descWrite.IPPayloadError
+                checksum->Layer4 = descLast.IPPayloadError
                     ? NetPacketRxChecksumEvaluationInvalid
                     : NetPacketRxChecksumEvaluationValid;
-                switch (descWrite.PayloadType)
+                switch (descLast.PayloadType)
                 {
                 case RxPayloadTypeUdp:
                     pkt->Layout.Layer4Type = NetPacketLayer4TypeUdp;
@@ -203,19 +587,131 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
                     break;
                 }
             }
+
+            // MAC strips the outer VLAN tag and reports it in RDES0 (see DeviceD0Entry).
+            if (context->rxVlanTag)
+            {
+                auto const ieee = NetExtensionGetPacketIeee8021Q(&context->packetIeee8021q, pktIndex);
+                *ieee = {};
+                if (descLast.Rdes0Valid)
+                {
+                    ieee->PriorityCodePoint = descLast.OuterVlanTag >> 13;
+                    ieee->VlanIdentifier = descLast.OuterVlanTag & 0xFFF;
+                }
+            }
         }
 
+        if (context->copyBreak != 0)
+        {
+            // Dropped packets keep their buffers and use no fragments.
+            if (!ignore && !AttachBuffers(context, descIndex, descPacket, remaining, fragIndex))
+            {
+                TraceWrite("RxQueueAdvance-no-buffers", LEVEL_WARNING,
+                    TraceLoggingUInt32(descIndex, "descIndex"),
+                    TraceLoggingUInt32(descPacket, "descPacket"));
+                ignore = true;
+            }
+
+            if (ignore)
+            {
+                pkt->Ignore = true;
+                pkt->FragmentCount = 0;
+            }
+            else
+            {
+                fragIndex = NetRingAdvanceIndex(context->fragmentRing, fragIndex, descPacket);
+            }
+
+            descIndex = (descIndex + descPacket) & descMask;
+            doneFrags += descPacket;
+            donePackets += 1;
+            pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
+            continue;
+        }
+
+        pkt->Ignore = ignore;
+
+        if (context->splitHeader)
+        {
+            /*
+            Split header mode (jumbo frames disabled, so a good packet always has one
+            descriptor). If the MAC found L3/L4 headers, Buf1 holds HL bytes of headers
+            and Buf2 holds the payload. Otherwise Buf1 is filled first. If Buf2 is
+            empty, the packet has one fragment and the Buf2 fragment is unused.
+            */
+            NT_ASSERT(ignore || descPacket == 1);
+            for (UINT32 i = 0; i != descPacket; i += 1)
+            {
+                NT_ASSERT(context->descVirtual[descIndex].Write.FragmentIndex == fragIndex);
+                auto const headerLength = i == 0 && descLast.Rdes2Valid ? descLast.L3L4HeaderLength : 0u;
+
+                auto const frag1 = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+                frag1->Offset = 0;
+                frag1->ValidLength = headerLength != 0 && headerLength < remaining
+                    ? headerLength
+                    : min(remaining, RxBufferSize);
+                remaining -= static_cast<UINT32>(frag1->ValidLength);
+                fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+
+                auto const frag2 = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+                frag2->Offset = 0;
+                frag2->ValidLength = min(remaining, RxBufferSize);
+                remaining -= static_cast<UINT32>(frag2->ValidLength);
+                fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+
+                if (!ignore && frag2->ValidLength == 0)
+                {
+                    pkt->FragmentCount = 1;
+                }
+
+                descIndex = (descIndex + 1) & descMask;
+                doneFrags += 2;
+            }
+
+            donePackets += 1;
+            pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
+            continue;
+        }
+
+        // Each descriptor except the last is filled to RxBufferSize. The CRC may be split
+        // across the last two fragments, so assign lengths front to back.
+        for (UINT32 i = 0; i != descPacket; i += 1)
+        {
+            NT_ASSERT(fragIndex != fragEnd);
+            NT_ASSERT(context->descVirtual[descIndex].Write.FragmentIndex == fragIndex);
+
+            auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+            NT_ASSERT(RxBufferSize <= frag->Capacity);
+            frag->Offset = 0;
+            frag->ValidLength = min(remaining, RxBufferSize);
+            remaining -= static_cast<UINT32>(frag->ValidLength);
+
+            descIndex = (descIndex + 1) & descMask;
+            fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+            doneFrags += 1;
+        }
+
+        donePackets += 1;
         pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
-        fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
-        doneFrags += 1;
     }
 
+IndicateDone:
+
     context->descBegin = descIndex;
     context->packetRing->BeginIndex = pktIndex;
     context->fragmentRing->BeginIndex = fragIndex;
+    if (context->copyBreak != 0)
+    {
+        context->fragmentRing->NextIndex = fragIndex;
+    }
 
     if (context->running)
     {
+        if (context->moderation != RxInterruptModerationLowLatency)
+        {
+            RxModerationUpdate(context, donePackets);
+        }
+
         // Prepare more descriptors.
 
         fragIndex = context->fragmentRing->NextIndex;
@@ -223,19 +719,40 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
         auto const descFull = (context->descBegin - 1u) & descMask;
         for (descIndex = context->descEnd; descIndex != descFull; descIndex = (descIndex + 1) & descMask)
         {
-            if (fragIndex == fragEnd)
+            UINT64 fragLogicalAddress;
+            UINT64 frag2LogicalAddress = 0;
+            if (context->copyBreak != 0)
+            {
+                // Driver-managed: the descriptor's buffer was kept or replaced by AttachBuffers.
+                fragLogicalAddress = context->descBuffers[descIndex]->logicalAddress;
+            }
+            else if (NetRingGetRangeCount(context->fragmentRing, fragIndex, fragEnd) < (context->splitHeader ? 2u : 1u))
             {
                 break;
             }
-
-            NT_ASSERT(RxBufferSize <= NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex)->Capacity);
-            auto const fragLogicalAddress = NetExtensionGetFragmentLogicalAddress(&context->fragmentLogical, fragIndex)->LogicalAddress;
+            else
+            {
+                NT_ASSERT(RxBufferSize <= NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex)->Capacity);
+                fragLogicalAddress = NetExtensionGetFragmentLogicalAddress(&context->fragmentLogical, fragIndex)->LogicalAddress;
+                if (context->splitHeader)
+                {
+                    auto const frag2Index = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+                    NT_ASSERT(RxBufferSize <= NetRingGetFragmentAtIndex(context->fragmentRing, frag2Index)->Capacity);
+                    frag2LogicalAddress = NetExtensionGetFragmentLogicalAddress(&context->fragmentLogical, frag2Index)->LogicalAddress;
+                }
+            }
 
             RxDescriptorRead descRead = {};
             descRead.Buf1ApLow = fragLogicalAddress & 0xFFFFFFFF;
             descRead.Buf1ApHigh = fragLogicalAddress >> 32;
             descRead.Buf1Valid = true;
-            descRead.InterruptOnCompletion = true;
+            if (context->splitHeader)
+            {
+                descRead.Buf2ApLow = frag2LogicalAddress & 0xFFFFFFFF;
+                descRead.Buf2ApHigh = frag2LogicalAddress >> 32;
+                descRead.Buf2Valid = true;
+            }
+            descRead.InterruptOnCompletion = (descIndex & context->iocMask) == context->iocMask;
             descRead.Own = true;
 #if DBG
             descRead.FragmentIndex = fragIndex;
@@ -243,7 +760,10 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
 
             context->descVirtual[descIndex].Read = descRead;
 
-            fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+            if (context->copyBreak == 0)
+            {
+                fragIndex = NetRingAdvanceIndex(context->fragmentRing, fragIndex, context->splitHeader ? 2u : 1u);
+            }
             queuedFrags += 1;
         }
 
@@ -253,7 +773,10 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
         if (descIndex != descNext)
         {
             SetDescEnd(context, descIndex);
-            context->fragmentRing->NextIndex = fragIndex;
+            if (context->copyBreak == 0)
+            {
+                context->fragmentRing->NextIndex = fragIndex;
+            }
         }
     }
     else if (descIndex == descNext)
@@ -262,18 +785,38 @@ RxQueueAdvance(_In_ NETPACKETQUEUE queue)
         {
             auto const pkt = NetRingGetPacketAtIndex(context->packetRing, pktIndex);
             pkt->Ignore = true;
+            if (context->copyBreak != 0)
+            {
+                pkt->FragmentCount = 0;
+            }
             pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
         }
 
+        if (context->copyBreak != 0)
+        {
+            // Driver-managed: no buffer was attached to these fragments and their return
+            // contexts may still name buffers indicated earlier. Clear them so that a
+            // return can't put a buffer on the free list twice.
+            for (fragIndex = context->fragmentRing->BeginIndex; fragIndex != fragEnd;
+                fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex))
+            {
+                NetExtensionGetFragmentReturnContext(&context->fragmentReturn, fragIndex)->Handle = nullptr;
+            }
+
+            context->fragmentRing->NextIndex = fragEnd;
+        }
+
         context->packetRing->BeginIndex = pktEnd;
         context->fragmentRing->BeginIndex = fragEnd;
     }
 
-    DeviceAddStatisticsRxQueue(context->deviceContext, ownDescriptors, doneFrags);
+    DeviceAddStatisticsRxQueue(context->deviceContext, context->channel, ownDescriptors, doneFrags,
+        donePackets, descReceived, context->descCount, filterMatches);
 
     TraceEntryExit(RxQueueAdvance, LEVEL_VERBOSE,
         TraceLoggingUInt32(ownDescriptors),
         TraceLoggingUInt32(doneFrags),
+        TraceLoggingUInt32(donePackets),
         TraceLoggingUInt32(queuedFrags));
 }
 
@@ -285,7 +828,7 @@ RxQueueSetNotificationEnabled(
 {
     // PASSIVE_LEVEL, nonpaged (resume path)
     auto const context = RxQueueGetContext(queue);
-    DeviceSetNotificationRxQueue(context->deviceContext, notificationEnabled ? queue : nullptr);
+    DeviceSetNotificationRxQueue(context->deviceContext, context->channel, notificationEnabled ? queue : nullptr);
     TraceEntryExit(RxQueueSetNotificationEnabled, LEVEL_VERBOSE,
         TraceLoggingBoolean(notificationEnabled, "enabled"));
 }
@@ -318,7 +861,8 @@ RxQueueStop(_In_ NETPACKETQUEUE queue)
     PAGED_CODE();
     auto const context = RxQueueGetContext(queue);
 
-    DeviceSetNotificationRxQueue(context->deviceContext, nullptr);
+    DeviceSetNotificationRxQueue(context->deviceContext, context->channel, nullptr);
+    DeviceSetRxQueueStarted(context->deviceContext, context->channel, false);
 
     TraceEntryExit(RxQueueStop, LEVEL_INFO);
 }
@@ -338,12 +882,135 @@ RxQueueCleanup(_In_ WDFOBJECT queue)
     TraceEntryExit(RxQueueCleanup, LEVEL_VERBOSE);
 }
 
+// Driver-managed buffers: allocates the DMA and copy-break buffer pools and attaches
+// a DMA buffer to each descriptor. Allocations are parented to the queue. NetAdapterCx
+// returns all indicated buffers before the queue is deleted.
+static NTSTATUS
+RxQueueCreateBuffers(
+    _In_ NETPACKETQUEUE queue,
+    _Inout_ RxQueueContext* context,
+    _In_ WDFDMAENABLER dma)
+{
+    // PASSIVE_LEVEL, nonpaged (resume path)
+    NTSTATUS status;
+    auto const descCount = context->descCount;
+    auto const dmaCount = (descCount + descCount / 2u + RxBuffersPerChunk - 1u) / RxBuffersPerChunk * RxBuffersPerChunk;
+    auto const smallCount = descCount;
+    auto const totalCount = dmaCount + smallCount;
+    context->smallSize = static_cast<UINT16>(
+        (context->copyBreak + RxSmallBufferAlignment - 1u) & ~(RxSmallBufferAlignment - 1u));
+
+    WDF_OBJECT_ATTRIBUTES attributes;
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = queue;
+
+    status = WdfSpinLockCreate(&attributes, &context->bufferLock);
+    if (!NT_SUCCESS(status))
+    {
+        TraceWrite("WdfSpinLockCreate-failed", LEVEL_ERROR,
+            TraceLoggingNTStatus(status));
+        goto Done;
+    }
+
+    // Bookkeeping: buffers[totalCount], descBuffers[descCount], dmaFree[dmaCount], smallFree[smallCount].
+    RxBuffer* buffers;
+    {
+        WDFMEMORY memory;
+        void* memoryVirtual;
+        status = WdfMemoryCreate(&attributes, NonPagedPoolNx, 0,
+            sizeof(RxBuffer) * totalCount + sizeof(RxBuffer*) * (descCount + dmaCount + smallCount),
+            &memory, &memoryVirtual);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfMemoryCreate-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+
+        buffers = static_cast<RxBuffer*>(memoryVirtual);
+        context->descBuffers = reinterpret_cast<RxBuffer**>(buffers + totalCount);
+        context->dmaFree = context->descBuffers + descCount;
+        context->smallFree = context->dmaFree + dmaCount;
+    }
+
+    // DMA buffers: the first descCount are attached to descriptors, the rest are spares.
+    for (UINT32 chunkStart = 0; chunkStart != dmaCount; chunkStart += RxBuffersPerChunk)
+    {
+        WDFCOMMONBUFFER chunk;
+        status = WdfCommonBufferCreate(dma, RxBufferChunkSize, &attributes, &chunk);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfCommonBufferCreate-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+
+        auto const chunkVirtual = static_cast<UINT8*>(WdfCommonBufferGetAlignedVirtualAddress(chunk));
+        auto const chunkLogical = WdfCommonBufferGetAlignedLogicalAddress(chunk).QuadPart;
+        for (UINT32 i = 0; i != RxBuffersPerChunk; i += 1)
+        {
+            auto const index = chunkStart + i;
+            auto const buffer = &buffers[index];
+            buffer->virtualAddress = chunkVirtual + i * RxBufferSize;
+            buffer->logicalAddress = chunkLogical + i * RxBufferSize;
+            buffer->context = context;
+            buffer->small = false;
+
+            if (index < descCount)
+            {
+                context->descBuffers[index] = buffer;
+            }
+            else
+            {
+                context->dmaFree[context->dmaFreeCount] = buffer;
+                context->dmaFreeCount += 1;
+            }
+        }
+    }
+
+    // Copy-break buffers.
+    {
+        WDFMEMORY memory;
+        void* memoryVirtual;
+        status = WdfMemoryCreate(&attributes, NonPagedPoolNx, 0,
+            context->smallSize * smallCount, &memory, &memoryVirtual);
+        if (!NT_SUCCESS(status))
+        {
+            TraceWrite("WdfMemoryCreate-failed", LEVEL_ERROR,
+                TraceLoggingNTStatus(status));
+            goto Done;
+        }
+
+        for (UINT32 i = 0; i != smallCount; i += 1)
+        {
+            auto const buffer = &buffers[dmaCount + i];
+            buffer->virtualAddress = static_cast<UINT8*>(memoryVirtual) + i * context->smallSize;
+            buffer->logicalAddress = 0;
+            buffer->context = context;
+            buffer->small = true;
+
+            context->smallFree[context->smallFreeCount] = buffer;
+            context->smallFreeCount += 1;
+        }
+    }
+
+    TraceWrite("RxQueueCreate-buffers", LEVEL_VERBOSE,
+        TraceLoggingUInt32(dmaCount, "dmaBuffers"),
+        TraceLoggingUInt32(smallCount, "smallBuffers"),
+        TraceLoggingUInt16(context->smallSize, "smallSize"));
+
+Done:
+
+    return status;
+}
+
 _Use_decl_annotations_ NTSTATUS
 RxQueueCreate(
     DeviceContext* deviceContext,
     DeviceConfig const& deviceConfig,
     NETRXQUEUE_INIT* queueInit,
     WDFDMAENABLER dma,
+    UINT8 channel,
     ChannelRegisters* channelRegs)
 {
     // PASSIVE_LEVEL, nonpaged (resume path)
@@ -378,12 +1045,29 @@ RxQueueCreate(
 
         auto const context = RxQueueGetContext(queue);
         context->channelRegs = channelRegs;
+        context->channel = channel;
 
         context->deviceContext = deviceContext;
         context->packetRing = NetRingCollectionGetPacketRing(rings);
         context->fragmentRing = NetRingCollectionGetFragmentRing(rings);
-        context->descCount = QueueDescriptorCount(context->fragmentRing->NumberOfElements);
+        context->splitHeader = deviceConfig.rxSplitHeader;
+        context->descCount = QueueDescriptorCount(
+            context->fragmentRing->NumberOfElements / (context->splitHeader ? 2u : 1u));
         context->rxPbl = deviceConfig.rxPbl;
+        context->moderation = deviceConfig.rxInterruptModeration;
+        context->copyBreak = deviceConfig.rxCopyBreak;
+        context->rxVlanTag = deviceConfig.priorityVlanTag != 0;
+        context->ptpTimestamp = deviceConfig.ptpTimestamp;
+        for (unsigned i = 0; i != L3L4FiltersMax; i += 1)
+        {
+            auto const& filter = deviceConfig.l3l4Filters[i];
+            if (filter.protocol != L3L4FilterProtocolNone &&
+                filter.action == L3L4FilterActionDrop)
+            {
+                context->l3l4DropFilters |= 1u << i;
+            }
+        }
+        NT_ASSERT(!context->splitHeader || context->copyBreak == 0);
 
         TraceWrite("RxQueueCreate-size", LEVEL_VERBOSE,
             TraceLoggingHexInt32(context->packetRing->NumberOfElements, "packets"),
@@ -422,11 +1106,46 @@ RxQueueCreate(
             NetExtensionTypePacket);
         NetRxQueueGetExtension(queue, &query, &context->packetChecksum);
 
-        NET_EXTENSION_QUERY_INIT(&query,
-            NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_NAME,
-            NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_VERSION_1,
-            NetExtensionTypeFragment);
-        NetRxQueueGetExtension(queue, &query, &context->fragmentLogical);
+        if (context->rxVlanTag)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_PACKET_EXTENSION_IEEE8021Q_NAME,
+                NET_PACKET_EXTENSION_IEEE8021Q_VERSION_1,
+                NetExtensionTypePacket);
+            NetRxQueueGetExtension(queue, &query, &context->packetIeee8021q);
+        }
+
+        if (context->copyBreak != 0 || context->ptpTimestamp)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_NAME,
+                NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_VERSION_1,
+                NetExtensionTypeFragment);
+            NetRxQueueGetExtension(queue, &query, &context->fragmentVirtual);
+        }
+
+        if (context->copyBreak != 0)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_FRAGMENT_EXTENSION_RETURN_CONTEXT_NAME,
+                NET_FRAGMENT_EXTENSION_RETURN_CONTEXT_VERSION_1,
+                NetExtensionTypeFragment);
+            NetRxQueueGetExtension(queue, &query, &context->fragmentReturn);
+
+            status = RxQueueCreateBuffers(queue, context, dma);
+            if (!NT_SUCCESS(status))
+            {
+                goto Done;
+            }
+        }
+        else
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_NAME,
+                NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_VERSION_1,
+                NetExtensionTypeFragment);
+            NetRxQueueGetExtension(queue, &query, &context->fragmentLogical);
+        }
     }
 
     status = STATUS_SUCCESS;
@@ -8,6 +8,22 @@ struct DeviceConfig;
 struct ChannelRegisters;
 auto constexpr RxBufferSize = 2048u;
 
+// Ndi\params\RxCopyBreak: received frames up to this size are copied into small
+// buffers so the DMA buffer can be reused immediately. 0 = system-managed buffers.
+// Off by default: the driver-managed pool holds 1.5 DMA buffers plus one small buffer
+// per descriptor, more than the one buffer per descriptor of system-managed mode.
+auto constexpr RxCopyBreakDefault = 0u;
+auto constexpr RxCopyBreakMax = 512u;
+
+// Ndi\params\RxInterruptModeration values.
+enum RxInterruptModeration : UINT8
+{
+    RxInterruptModerationLowLatency = 0,    // Interrupt on every descriptor.
+    RxInterruptModerationBalanced = 1,      // Adapt to packet rate.
+    RxInterruptModerationThroughput = 2,    // Adapt to packet rate, never interrupt on every descriptor.
+    RxInterruptModerationMax
+};
+
 // Called by device.cpp AdapterCreateRxQueue.
 _IRQL_requires_same_
 _IRQL_requires_(PASSIVE_LEVEL)
@@ -17,4 +33,10 @@ RxQueueCreate(
     _In_ DeviceConfig const& deviceConfig,
     _Inout_ NETRXQUEUE_INIT* queueInit,
     _In_ WDFDMAENABLER dma,
+    UINT8 channel,
     _Inout_ ChannelRegisters* channelRegs);
+
+// Called by device.cpp AdapterReturnRxBuffer (driver-managed Rx buffers only).
+_IRQL_requires_max_(DISPATCH_LEVEL)
+void
+RxQueueReturnBuffer(_In_ NET_FRAGMENT_RETURN_CONTEXT_HANDLE returnContext);
@@ -8,6 +8,12 @@
 
 static_assert(sizeof(TxDescriptor) == QueueDescriptorSize);
 
+// Set IOC on every Nth packet. Completion of the remaining packets is reported by
+// the next IOC packet, or by the device's Tx completion timer if the queue goes idle.
+static UINT32 constexpr TxIocInterval = 16;
+
+static UINT32 constexpr TxVlanTagNone = 0x10000; // Not a valid 16-bit tag.
+
 struct TxQueueContext
 {
     ChannelRegisters* channelRegs;
@@ -19,10 +25,21 @@ struct TxQueueContext
     TxDescriptor* descVirtual;
     PHYSICAL_ADDRESS descPhysical;
     NET_EXTENSION packetChecksum;
+    NET_EXTENSION packetGso;
+    NET_EXTENSION packetIeee8021q;
     NET_EXTENSION fragmentLogical;
+    NET_EXTENSION fragmentVirtual; // Only if txTimestamp.
     UINT32 descCount;   // A power of 2 between QueueDescriptorMinCount and QueueDescriptorMaxCount.
+    UINT8 channel;      // DMA channel (and MTL queue) index.
     UINT8 txPbl;
     bool txChecksumOffload;
+    bool txTso;
+    bool txTimestamp;   // Request a timestamp for non-TSO PTP event messages (PTP clock enabled).
+    UINT8 txPriorityVlanTag; // DeviceConfig::priorityVlanTag: bit 0 = priority, bit 1 = VLAN.
+    UINT16 txVlanId;    // VLAN ID to insert if the packet doesn't specify one, 0 if none.
+    UINT16 tsoMss;      // MSS most recently sent to the channel in a context descriptor, 0 if none.
+    UINT32 vlanTag;     // VLAN tag most recently sent to the channel in a context descriptor, TxVlanTagNone if none.
+    UINT32 packetsSinceIoc; // Packets queued after the most recent packet with IOC.
 
     UINT32 descBegin;   // Start of the TRANSMIT region.
     UINT32 descEnd;     // End of the TRANSMIT region, start of the EMPTY region.
@@ -51,6 +68,51 @@ SetDescEnd(
     context->descEnd = index;
 }
 
+// Returns the number of descriptors needed for a buffer of the given length.
+static UINT32
+BufferDescriptorCount(UINT32 length)
+{
+    // DISPATCH_LEVEL
+    return length <= TxBufferLengthMax ? 1u
+        : (length + TxBufferLengthMax - 1u) / TxBufferLengthMax;
+}
+
+// Returns true and sets *id if the packet whose fragments start at fragIndex is a
+// PTP event message. The headers may span fragments.
+static bool
+TxPtpEventMessage(
+    _In_ TxQueueContext const* context,
+    UINT32 fragIndex,
+    UINT32 fragmentCount,
+    _Out_ PtpMessageId* id)
+{
+    // DISPATCH_LEVEL
+    NT_ASSERT(context->txTimestamp);
+
+    auto const frag0 = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+    auto const virtual0 = static_cast<UINT8 const*>(
+        NetExtensionGetFragmentVirtualAddress(&context->fragmentVirtual, fragIndex)->VirtualAddress) + frag0->Offset;
+    if (frag0->ValidLength >= QueuePtpFrameHeaderMax || fragmentCount == 1)
+    {
+        return QueuePtpEventMessage(virtual0, static_cast<UINT32>(frag0->ValidLength), id);
+    }
+
+    UINT8 headers[QueuePtpFrameHeaderMax];
+    UINT32 headersLength = 0;
+    for (UINT32 i = 0; i != fragmentCount && headersLength != sizeof(headers); i += 1)
+    {
+        auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
+        auto const copy = static_cast<UINT32>(min(frag->ValidLength, sizeof(headers) - headersLength));
+        memcpy(headers + headersLength,
+            static_cast<UINT8 const*>(NetExtensionGetFragmentVirtualAddress(&context->fragmentVirtual, fragIndex)->VirtualAddress) + frag->Offset,
+            copy);
+        headersLength += copy;
+        fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
+    }
+
+    return QueuePtpEventMessage(headers, headersLength, id);
+}
+
 static EVT_PACKET_QUEUE_START TxQueueStart;
 static void
 TxQueueStart(_In_ NETPACKETQUEUE queue)
@@ -60,6 +122,9 @@ TxQueueStart(_In_ NETPACKETQUEUE queue)
 
     context->descBegin = 0;
     context->descEnd = 0;
+    context->tsoMss = 0;
+    context->vlanTag = TxVlanTagNone;
+    context->packetsSinceIoc = 0;
 
     Write32(&context->channelRegs->TxDesc_List_Address_Hi,context->descPhysical.HighPart);
     Write32(&context->channelRegs->TxDesc_List_Address, context->descPhysical.LowPart);
@@ -74,6 +139,7 @@ TxQueueStart(_In_ NETPACKETQUEUE queue)
     ChannelTxControl_t txControl = {};
     txControl.Start = true;
     txControl.OperateOnSecondPacket = true;
+    txControl.TcpSegmentation = context->txTso;
     txControl.TxPbl = context->txPbl;
     Write32(&context->channelRegs->Tx_Control, txControl);
 
@@ -91,7 +157,7 @@ TxQueueAdvance(_In_ NETPACKETQUEUE queue)
     auto const pktEnd = context->packetRing->EndIndex;
     auto const descMask = context->descCount - 1u;
     UINT32 descIndex, pktIndex, fragIndex;
-    UINT32 ownDescriptors = 0, doneFrags = 0, queuedFrags = 0;
+    UINT32 ownDescriptors = 0, doneFrags = 0, donePackets = 0, queuedFrags = 0;
 
     /*
     Packet indexes:
@@ -106,7 +172,23 @@ TxQueueAdvance(_In_ NETPACKETQUEUE queue)
     pktIndex = pktBegin;
     fragIndex = context->fragmentRing->BeginIndex;
 
-    auto const descNext = GetDescNext(context);
+    // The TRANSMITTED region ends at the first descriptor still owned by the DMA engine.
+    // Current_App_TxDesc is only read when nothing was transmitted, to detect descriptors
+    // that the DMA engine has passed but whose write-back is not yet visible.
+    auto const descNext = QueueDescriptorFindOwned(context->descVirtual, context->descBegin, context->descEnd, context->descCount);
+    if (descNext == context->descBegin && descNext != context->descEnd)
+    {
+        auto const descCurrent = GetDescNext(context);
+        if (descCurrent != descNext)
+        {
+            TraceWrite("TxQueueAdvance-writeback-pending", LEVEL_VERBOSE,
+                TraceLoggingUInt32(descNext, "descIndex"),
+                TraceLoggingUInt32(descCurrent, "descCurrent"));
+            ownDescriptors = 1;
+        }
+    }
+
+    auto const descInFlight = (context->descEnd - context->descBegin) & descMask;
     descIndex = context->descBegin;
     auto descReady = (descNext - descIndex) & descMask; // Number of descriptors ready to be indicated.
     while (descIndex != descNext)
@@ -119,60 +201,68 @@ TxQueueAdvance(_In_ NETPACKETQUEUE queue)
         {
             NT_ASSERT(fragmentCount != 0);
 
-            if (fragmentCount > descReady)
+            // A packet usually has one descriptor per fragment, but a TSO packet may
+            // also have a context descriptor and a separate header descriptor, and a
+            // large fragment may be split across descriptors. Find the LD descriptor.
+            UINT32 descCount = 0; // Number of descriptors in the packet.
+            for (;;)
             {
-                break;
-            }
-
-            for (unsigned i = 0; i != fragmentCount; i += 1)
-            {
-                auto const descIndex2 = (descIndex + i) & descMask;
-                NT_ASSERT(descIndex2 != descNext);
+                if (descCount == descReady)
+                {
+                    goto DoneIndicating;
+                }
 
+                auto const descIndex2 = (descIndex + descCount) & descMask;
                 auto const& desc = context->descVirtual[descIndex2];
                 auto const descWrite = desc.Write;
                 NT_ASSERT(descWrite.PacketIndex == pktIndex);
-                NT_ASSERT(descWrite.FragmentIndex == NetRingAdvanceIndex(context->fragmentRing, pkt->FragmentIndex, i));
+                descCount += 1;
 
-                // Descriptor is still owned by the DMA engine?
-                if (descWrite.Own)
+                // descNext is the first descriptor still owned by the DMA engine, so
+                // everything before it has been written back. (Using Current_App_TxDesc
+                // instead would race with the write-back.)
+                NT_ASSERT(!descWrite.Own);
+                if (descWrite.ContextType)
                 {
-                    /*
-                    There's a race condition where we see the update to Current_App_TxDesc
-                    before we see the update to the descriptor. We don't want to write to
-                    the descriptor's memory while the update is in flight, but this is
-                    otherwise harmless (we only use the descriptor for assertions and
-                    logging), and a fix for this would likely affect performance, so just
-                    stop when we see a descriptor with the Own bit still set. We'll
-                    process it the next time we're called.
-
-                    This doesn't seem to happen in the Rx path.
-                    */
-                    TraceWrite("TxQueueAdvance-own", LEVEL_VERBOSE,
-                        TraceLoggingUInt32(descIndex2, "descIndex"),
-                        TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "TDES3"),
-                        TraceLoggingUInt32(i, "fragment"),
-                        TraceLoggingUInt32(fragmentCount));
-                    ownDescriptors = 1;
-                    goto DoneIndicating;
+                    if (desc.Context.DescriptorError)
+                    {
+                        TraceWrite("TxQueueAdvance-context-error", LEVEL_ERROR,
+                            TraceLoggingUInt32(descIndex2, "descIndex"),
+                            TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "TDES3"));
+                    }
                 }
                 else if (
                     descWrite.ErrorSummary ||
-                    descWrite.ContextType ||
-                    descWrite.DescriptorError ||
-                    (descWrite.LastDescriptor != 0) != (i == fragmentCount - 1u))
+                    descWrite.DescriptorError)
                 {
                     TraceWrite("TxQueueAdvance-error", LEVEL_ERROR,
                         TraceLoggingUInt32(descIndex2, "descIndex"),
                         TraceLoggingHexInt32(reinterpret_cast<UINT32 const*>(&descWrite)[3], "TDES3"),
-                        TraceLoggingUInt32(i, "fragment"),
+                        TraceLoggingUInt32(descCount - 1u, "descriptor"),
                         TraceLoggingUInt32(fragmentCount));
                 }
+
+                if (!descWrite.ContextType && descWrite.LastDescriptor)
+                {
+                    // TTSE is only set for PTP event messages, so parse the packet again
+                    // to get the message's identity.
+                    PtpMessageId id;
+                    if (descWrite.TimestampStatus &&
+                        TxPtpEventMessage(context, pkt->FragmentIndex, fragmentCount, &id))
+                    {
+                        DeviceSetPacketTimestamp(context->deviceContext, true,
+                            id.messageType, id.sequenceId,
+                            descWrite.TimestampHigh, descWrite.TimestampLow);
+                    }
+
+                    break;
+                }
             }
 
             doneFrags += fragmentCount;
-            descReady -= fragmentCount;
-            descIndex = (descIndex + fragmentCount) & descMask;
+            donePackets += 1;
+            descReady -= descCount;
+            descIndex = (descIndex + descCount) & descMask;
         }
 
         pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
@@ -185,6 +275,11 @@ DoneIndicating:
     context->fragmentRing->BeginIndex = fragIndex;
     context->descBegin = descIndex;
 
+    if (context->descBegin == context->descEnd)
+    {
+        context->packetsSinceIoc = 0; // Nothing left in flight.
+    }
+
     // Fill more descriptors.
 
     pktIndex = pktNext;
@@ -193,6 +288,8 @@ DoneIndicating:
     auto const txChecksumOffload = context->txChecksumOffload;
     auto const descEnd = context->descEnd;
     auto descEmpty = ((context->descBegin - 1) - descEnd) & descMask;
+    UINT32 descLastQueued = descMask + 1; // LD descriptor of the most recently queued packet, if any.
+    bool ringFull = false;
     descIndex = descEnd;
     while (descEmpty != 0)
     {
@@ -222,52 +319,221 @@ DoneIndicating:
 
             auto const fragmentCount = pkt->FragmentCount;
             NT_ASSERT(fragmentCount != 0);
-            if (fragmentCount > descEmpty)
+
+            // If TSO is disabled by hardware then we can't call NetExtensionGetPacketGso.
+            // If TSO is disabled by software then the extension will be zeroed.
+            UINT32 const mss = context->txTso
+                ? NetExtensionGetPacketGso(&context->packetGso, pktIndex)->TCP.Mss
+                : 0u;
+            UINT32 const headerLength = mss == 0 ? 0u
+                : pkt->Layout.Layer2HeaderLength + pkt->Layout.Layer3HeaderLength + pkt->Layout.Layer4HeaderLength;
+
+            // If tagging is disabled by hardware then we can't call NetExtensionGetPacketIeee8021Q.
+            // Otherwise, the stack's PCP/VID take precedence over the configured VlanID.
+            UINT32 vlanTag = TxVlanTagNone;
+            if (context->txPriorityVlanTag != 0)
             {
-                break;
+                auto const ieee = *NetExtensionGetPacketIeee8021Q(&context->packetIeee8021q, pktIndex);
+                UINT16 const pcp = (ieee.TxTagging & NetPacketTxIeee8021qActionFlagPriorityRequired)
+                    ? ieee.PriorityCodePoint : 0u;
+                UINT16 const vid = (ieee.TxTagging & NetPacketTxIeee8021qActionFlagVlanRequired)
+                    ? ieee.VlanIdentifier : context->txVlanId;
+                if (pcp != 0 || vid != 0)
+                {
+                    vlanTag = (pcp << 13) | (vid & 0xFFF);
+                }
             }
 
+            bool const contextMss = mss != 0 && mss != context->tsoMss;
+            bool const contextVlan = vlanTag != TxVlanTagNone && vlanTag != context->vlanTag;
+
+            // Count the descriptors needed for this packet.
+
             UINT32 frameLength = 0;
+            UINT32 descNeeded = contextMss || contextVlan ? 1u : 0u; // Context descriptor.
             for (unsigned i = 0, fragIndex2 = fragIndex; i != fragmentCount; i += 1)
             {
-                frameLength += NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex2)->ValidLength & 0x03FFFFFF; // 26 bits
+                UINT32 fragLength = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex2)->ValidLength & 0x03FFFFFF; // 26 bits
+                frameLength += fragLength;
+                if (i == 0 && headerLength != 0)
+                {
+                    // TSO: the header gets its own descriptor and must be in the first fragment.
+                    descNeeded += 1;
+                    fragLength = fragLength > headerLength ? fragLength - headerLength : 0u;
+                    descNeeded += fragLength == 0 ? 0u : BufferDescriptorCount(fragLength);
+                }
+                else
+                {
+                    descNeeded += BufferDescriptorCount(fragLength);
+                }
                 fragIndex2 = NetRingIncrementIndex(context->fragmentRing, fragIndex2);
             }
-            NT_ASSERT(frameLength <= 0x7FFF);
-            frameLength &= 0x7FFF;
 
+            if (headerLength != 0 && (
+                pkt->Layout.Layer4HeaderLength > 60 ||
+                headerLength >= frameLength ||
+                headerLength > NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex)->ValidLength ||
+                mss > 0x3FFF))
+            {
+                // Header not contiguous in the first fragment, or limits exceeded. Drop the packet.
+                TraceWrite("TxQueueAdvance-bad-tso", LEVEL_ERROR,
+                    TraceLoggingUInt32(pktIndex, "pktIndex"),
+                    TraceLoggingUInt32(mss),
+                    TraceLoggingUInt32(headerLength),
+                    TraceLoggingUInt32(frameLength));
+                pkt->Ignore = true;
+                pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
+                continue;
+            }
+
+            NT_ASSERT(descNeeded <= fragmentCount + TxExtraDescriptorsMax);
+            if (descNeeded > descEmpty)
+            {
+                ringFull = true;
+                break;
+            }
+
+            context->packetsSinceIoc += 1;
+            bool const packetIoc = context->packetsSinceIoc >= TxIocInterval;
+            if (packetIoc)
+            {
+                context->packetsSinceIoc = 0;
+            }
+
+            NT_ASSERT(mss != 0 || frameLength <= 0x7FFF);
+
+            // If MSS (TSO) or VLAN tag changed, send it to the channel with a context
+            // descriptor. The channel keeps both values for subsequent packets.
+
+            if (contextMss || contextVlan)
+            {
+                TxDescriptorContext descContext = {};
+                if (contextMss)
+                {
+                    descContext.MaximumSegmentSize = mss & 0x3FFF;
+                    descContext.OneStepInputOrMssValid = true;
+                    context->tsoMss = static_cast<UINT16>(mss);
+                }
+
+                if (contextVlan)
+                {
+                    descContext.VlanTag = static_cast<UINT16>(vlanTag);
+                    descContext.VlanTagValid = true;
+                    context->vlanTag = vlanTag;
+                }
+
+                descContext.ContextType = true;
+                descContext.Own = true;
+#if DBG
+                descContext.PacketIndex = pktIndex;
+                descContext.FragmentIndex = fragIndex;
+#endif
+
+                context->descVirtual[descIndex].Context = descContext;
+                descIndex = (descIndex + 1) & descMask;
+            }
+
+            auto const vlanTagControl = vlanTag != TxVlanTagNone
+                ? TxVlanTagControlInsert
+                : TxVlanTagControlNone;
+
+            // Only PTP event messages get a timestamp. The MAC keeps one Tx timestamp
+            // per packet, and the stack matches it to the message by sequenceId.
+            PtpMessageId ptpId;
+            bool const ptpEvent = context->txTimestamp && headerLength == 0 &&
+                TxPtpEventMessage(context, fragIndex, fragmentCount, &ptpId);
+
+            bool firstDescriptor = headerLength == 0; // For TSO, FD is on the header descriptor.
             for (unsigned i = 0; i != fragmentCount; i += 1)
             {
                 auto const frag = NetRingGetFragmentAtIndex(context->fragmentRing, fragIndex);
                 NT_ASSERT(frag->ValidLength <= frag->Capacity - frag->Offset);
-                auto const fragLogicalAddress = NetExtensionGetFragmentLogicalAddress(&context->fragmentLogical, fragIndex)->LogicalAddress;
-
-                TxDescriptorRead descRead = {};
-                descRead.Buf1Ap = static_cast<UINT32>(fragLogicalAddress);
-                descRead.Buf2Ap = static_cast<UINT32>(fragLogicalAddress >> 32);
-                NT_ASSERT(frag->ValidLength <= 0x3FFF); // 14 bits
-                descRead.Buf1Length = frag->ValidLength & 0x3FFF;
-                descRead.InterruptOnCompletion = i == fragmentCount - 1u;
-                descRead.FrameLength = static_cast<UINT16>(frameLength);
-                descRead.ChecksumInsertion = checksumInsertion;
-                descRead.LastDescriptor = i == fragmentCount - 1u;
-                descRead.FirstDescriptor = i == 0;
-                descRead.Own = true;
+                auto fragLogicalAddress = NetExtensionGetFragmentLogicalAddress(&context->fragmentLogical, fragIndex)->LogicalAddress + frag->Offset;
+                UINT32 fragLength = frag->ValidLength & 0x03FFFFFF; // 26 bits
+                UINT32 descCount;
+
+                if (i == 0 && headerLength != 0)
+                {
+                    // TSO: first descriptor holds only the header.
+                    TxDescriptorReadTso descTso = {};
+                    descTso.Buf1Ap = static_cast<UINT32>(fragLogicalAddress);
+                    descTso.Buf2Ap = static_cast<UINT32>(fragLogicalAddress >> 32);
+                    descTso.Buf1Length = headerLength & 0x3FF;
+                    descTso.TcpPayloadLength = (frameLength - headerLength) & 0x3FFFF;
+                    descTso.TcpSegmentationEnable = true;
+                    descTso.TcpHeaderLength = pkt->Layout.Layer4HeaderLength / 4u;
+                    descTso.VlanTagControl = vlanTagControl;
+                    descTso.FirstDescriptor = true;
+                    descTso.Own = true;
 #if DBG
-                descRead.PacketIndex = pktIndex;
-                descRead.FragmentIndex = fragIndex;
+                    descTso.PacketIndex = pktIndex;
+                    descTso.FragmentIndex = fragIndex;
 #endif
 
-                context->descVirtual[descIndex].Read = descRead;
-                descIndex = (descIndex + 1) & descMask;
+                    context->descVirtual[descIndex].ReadTso = descTso;
+                    descIndex = (descIndex + 1) & descMask;
+
+                    fragLogicalAddress += headerLength;
+                    fragLength -= headerLength;
+                    descCount = fragLength == 0 ? 0u : BufferDescriptorCount(fragLength);
+                }
+                else
+                {
+                    descCount = BufferDescriptorCount(fragLength);
+                }
+
+                for (; descCount != 0; descCount -= 1)
+                {
+                    auto const bufLength = min(fragLength, TxBufferLengthMax);
+                    bool const lastDescriptor = i == fragmentCount - 1u && descCount == 1;
+
+                    TxDescriptorRead descRead = {};
+                    descRead.Buf1Ap = static_cast<UINT32>(fragLogicalAddress);
+                    descRead.Buf2Ap = static_cast<UINT32>(fragLogicalAddress >> 32);
+                    descRead.Buf1Length = bufLength & 0x3FFF;
+                    descRead.InterruptOnCompletion = lastDescriptor && packetIoc;
+                    if (headerLength == 0) // Reserved in TSO payload descriptors.
+                    {
+                        descRead.FrameLength = static_cast<UINT16>(frameLength & 0x7FFF);
+                        descRead.ChecksumInsertion = checksumInsertion;
+                    }
+                    descRead.LastDescriptor = lastDescriptor;
+                    descRead.FirstDescriptor = firstDescriptor;
+                    descRead.VlanTagControl = firstDescriptor ? vlanTagControl : TxVlanTagControlNone;
+                    descRead.TransmitTimestampEnable = firstDescriptor && ptpEvent;
+                    descRead.Own = true;
+#if DBG
+                    descRead.PacketIndex = pktIndex;
+                    descRead.FragmentIndex = fragIndex;
+#endif
+
+                    context->descVirtual[descIndex].Read = descRead;
+                    descLastQueued = descIndex;
+                    descIndex = (descIndex + 1) & descMask;
+                    fragLogicalAddress += bufLength;
+                    fragLength -= bufLength;
+                    firstDescriptor = false;
+                }
+
                 fragIndex = NetRingIncrementIndex(context->fragmentRing, fragIndex);
                 queuedFrags += 1;
             }
+
+            descEmpty -= descNeeded;
         }
 
         pktIndex = NetRingIncrementIndex(context->packetRing, pktIndex);
     }
 
+    // If the ring is full, request an interrupt for the last queued packet so that we
+    // find out as soon as space is available. The device hasn't seen this descriptor
+    // yet because the tail pointer has not been updated.
+    if (ringFull && context->packetsSinceIoc != 0 && descLastQueued <= descMask)
+    {
+        context->descVirtual[descLastQueued].Read.InterruptOnCompletion = true;
+        context->packetsSinceIoc = 0;
+    }
+
     // In some error cases, the device may stall until we write to the tail pointer
     // again. Write to the tail pointer if there are pending descriptors, even if we
     // didn't fill any new ones.
@@ -277,11 +543,13 @@ DoneIndicating:
         context->packetRing->NextIndex = pktIndex;
     }
 
-    DeviceAddStatisticsTxQueue(context->deviceContext, ownDescriptors, doneFrags);
+    DeviceAddStatisticsTxQueue(context->deviceContext, context->channel, ownDescriptors, doneFrags, donePackets,
+        descInFlight, context->descCount);
 
     TraceEntryExit(TxQueueAdvance, LEVEL_VERBOSE,
         TraceLoggingUInt32(ownDescriptors),
         TraceLoggingUInt32(doneFrags),
+        TraceLoggingUInt32(donePackets),
         TraceLoggingUInt32(queuedFrags));
 }
 
@@ -293,9 +561,17 @@ TxQueueSetNotificationEnabled(
 {
     // PASSIVE_LEVEL, nonpaged (resume path)
     auto const context = TxQueueGetContext(queue);
-    DeviceSetNotificationTxQueue(context->deviceContext, notificationEnabled ? queue : nullptr);
+    DeviceSetNotificationTxQueue(context->deviceContext, context->channel, notificationEnabled ? queue : nullptr);
+
+    // Packets queued after the last IOC packet won't raise an interrupt.
+    if (notificationEnabled && context->packetsSinceIoc != 0)
+    {
+        DeviceStartTxCompletionTimer(context->deviceContext, context->channel);
+    }
+
     TraceEntryExit(TxQueueSetNotificationEnabled, LEVEL_VERBOSE,
-        TraceLoggingBoolean(notificationEnabled, "enabled"));
+        TraceLoggingBoolean(notificationEnabled, "enabled"),
+        TraceLoggingUInt32(context->packetsSinceIoc, "packetsSinceIoc"));
 }
 
 static EVT_PACKET_QUEUE_CANCEL TxQueueCancel;
@@ -391,7 +667,7 @@ TxQueueStop(_In_ NETPACKETQUEUE queue)
 
     context->descBegin = 0;
     context->descEnd = 0;
-    DeviceSetNotificationTxQueue(context->deviceContext, nullptr);
+    DeviceSetNotificationTxQueue(context->deviceContext, context->channel, nullptr);
 
     TraceEntryExit(TxQueueStop, LEVEL_INFO);
 }
@@ -417,6 +693,7 @@ TxQueueCreate(
     DeviceConfig const& deviceConfig,
     NETTXQUEUE_INIT* queueInit,
     WDFDMAENABLER dma,
+    UINT8 channel,
     ChannelRegisters* channelRegs,
     MtlQueueRegisters* mtlRegs)
 {
@@ -452,6 +729,7 @@ TxQueueCreate(
 
         auto const context = TxQueueGetContext(queue);
         context->channelRegs = channelRegs;
+        context->channel = channel;
         context->mtlRegs = mtlRegs;
         context->deviceContext = deviceContext;
         context->packetRing = NetRingCollectionGetPacketRing(rings);
@@ -459,6 +737,10 @@ TxQueueCreate(
         context->descCount = QueueDescriptorCount(context->fragmentRing->NumberOfElements);
         context->txPbl = deviceConfig.txPbl;
         context->txChecksumOffload = deviceConfig.txCoeSel;
+        context->txTso = deviceConfig.txCoeSel && deviceConfig.tsoEn;
+        context->txTimestamp = deviceConfig.ptpTimestamp;
+        context->txPriorityVlanTag = deviceConfig.priorityVlanTag;
+        context->txVlanId = (deviceConfig.priorityVlanTag & 2) ? deviceConfig.vlanId : 0u;
 
         TraceWrite("TxQueueCreate-size", LEVEL_VERBOSE,
             TraceLoggingHexInt32(context->packetRing->NumberOfElements, "packets"),
@@ -500,11 +782,38 @@ TxQueueCreate(
             NetTxQueueGetExtension(queue, &query, &context->packetChecksum);
         }
 
+        if (context->txTso)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_PACKET_EXTENSION_GSO_NAME,
+                NET_PACKET_EXTENSION_GSO_VERSION_1,
+                NetExtensionTypePacket);
+            NetTxQueueGetExtension(queue, &query, &context->packetGso);
+        }
+
+        if (context->txPriorityVlanTag != 0)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_PACKET_EXTENSION_IEEE8021Q_NAME,
+                NET_PACKET_EXTENSION_IEEE8021Q_VERSION_1,
+                NetExtensionTypePacket);
+            NetTxQueueGetExtension(queue, &query, &context->packetIeee8021q);
+        }
+
         NET_EXTENSION_QUERY_INIT(&query,
             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_NAME,
             NET_FRAGMENT_EXTENSION_LOGICAL_ADDRESS_VERSION_1,
             NetExtensionTypeFragment);
         NetTxQueueGetExtension(queue, &query, &context->fragmentLogical);
+
+        if (context->txTimestamp)
+        {
+            NET_EXTENSION_QUERY_INIT(&query,
+                NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_NAME,
+                NET_FRAGMENT_EXTENSION_VIRTUAL_ADDRESS_VERSION_1,
+                NetExtensionTypeFragment);
+            NetTxQueueGetExtension(queue, &query, &context->fragmentVirtual);
+        }
     }
 
     status = STATUS_SUCCESS;
@@ -7,6 +7,12 @@ struct DeviceContext;
 struct DeviceConfig;
 struct ChannelRegisters;
 struct MtlQueueRegisters;
+auto constexpr TxBufferLengthMax = 0x3FFFu; // TDES2 Buf1Length is 14 bits.
+auto constexpr TxTsoMaximumOffloadSize = 64000u;
+
+// Descriptors a packet may need beyond one per fragment: context descriptor (MSS or VLAN tag),
+// TSO header descriptor, and fragments split at TxBufferLengthMax.
+auto constexpr TxExtraDescriptorsMax = 2u + (TxTsoMaximumOffloadSize + 256u) / TxBufferLengthMax;
 
 // Called by device.cpp AdapterCreateTxQueue.
 _IRQL_requires_same_
@@ -17,5 +23,6 @@ TxQueueCreate(
     _In_ DeviceConfig const& deviceConfig,
     _Inout_ NETTXQUEUE_INIT* queueInit,
     _In_ WDFDMAENABLER dma,
+    UINT8 channel,
     _Inout_ ChannelRegisters* channelRegs,
     _Inout_ MtlQueueRegisters* mtlRegs);